@@ -17,6 +17,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include "esp_err.h"
 
 /**
@@ -93,15 +94,61 @@ struct led_strip_s {
     esp_err_t (*del)(led_strip_t *strip);
 };
 
+/**
+* @brief LED chipset, selects the bit timing or protocol and the default color order
+*
+*/
+typedef enum {
+    LED_STRIP_WS2812,       /*!< WS2812(B), clockless over RMT */
+    LED_STRIP_WS2811,       /*!< WS2811 in 800kHz mode, clockless over RMT */
+    LED_STRIP_WS2815,       /*!< WS2815, clockless over RMT */
+    LED_STRIP_SK6812_RGBW,  /*!< SK6812 RGBW, clockless over RMT, white is extracted from RGB */
+    LED_STRIP_APA102,       /*!< APA102, clocked over SPI */
+    LED_STRIP_SK9822,       /*!< SK9822, clocked over SPI */
+    LED_STRIP_TYPE_MAX,
+} led_strip_type_t;
+
+/**
+* @brief Order the color channels are sent in
+*
+*/
+typedef enum {
+    LED_STRIP_ORDER_DEFAULT, /*!< Whatever the chipset usually uses */
+    LED_STRIP_ORDER_RGB,
+    LED_STRIP_ORDER_RBG,
+    LED_STRIP_ORDER_GRB,
+    LED_STRIP_ORDER_GBR,
+    LED_STRIP_ORDER_BRG,
+    LED_STRIP_ORDER_BGR,
+    LED_STRIP_ORDER_MAX,
+} led_strip_order_t;
+
 /**
 * @brief LED Strip Configuration Type
 *
 */
 typedef struct {
-    uint32_t max_leds;   /*!< Maximum LEDs in a single strip */
-    led_strip_dev_t dev; /*!< LED strip device (e.g. RMT channel, PWM channel, etc) */
+    uint32_t max_leds;         /*!< Maximum LEDs in a single strip */
+    led_strip_dev_t dev;       /*!< LED strip device (e.g. RMT channel, SPI device handle, etc) */
+    led_strip_type_t type;     /*!< LED chipset */
+    led_strip_order_t order;   /*!< Color order, LED_STRIP_ORDER_DEFAULT to use the chipset's */
+    int gpio_num;              /*!< RMT only: data GPIO to install the channel on, -1 if the caller already installed it */
+    uint8_t mem_block_num;     /*!< RMT only: 64-item memory blocks for the channel, more blocks mean fewer refill interrupts */
+    int intr_flags;            /*!< RMT only: ESP_INTR_FLAG_* for the channel interrupt, e.g. its priority level */
+    int intr_core;             /*!< RMT only: core to service the channel interrupt on, -1 for the calling core */
+    void *storage;             /*!< Word aligned memory for the driver and its buffers, NULL to allocate from the heap */
+    uint32_t storage_size;     /*!< Size of storage, see LED_STRIP_RMT_STORAGE_SIZE() and LED_STRIP_SPI_STORAGE_SIZE() */
 } led_strip_config_t;
 
+/**
+* @brief Transmit statistics of a clockless LED strip, for the last refresh
+*
+*/
+typedef struct {
+    uint32_t translator_calls;  /*!< Times the RMT translator ran to fill the channel memory */
+    uint32_t translator_cycles; /*!< CPU cycles spent in the translator, nearly all of it in the RMT interrupt */
+} led_strip_rmt_stats_t;
+
 /**
  * @brief Default configuration for LED strip
  *
@@ -110,17 +157,97 @@ typedef struct {
     {                                             \
         .max_leds = number,                       \
         .dev = dev_hdl,                           \
+        .type = LED_STRIP_WS2812,                 \
+        .order = LED_STRIP_ORDER_DEFAULT,         \
+        .gpio_num = -1,                           \
+        .mem_block_num = 1,                       \
+        .intr_flags = 0,                          \
+        .intr_core = -1,                          \
+        .storage = NULL,                          \
+        .storage_size = 0,                        \
     }
 
+/**
+ * @brief Size of the SPI transfer for a clocked strip of n LEDs, for spi_bus_config_t::max_transfer_sz
+ *
+ * Start frame, 4 bytes per LED, then an end frame long enough to clock the data through every LED.
+ */
+#define LED_STRIP_SPI_TRANSFER_SIZE(n) (4 + (n) * 4 + 4 + ((n) + 15) / 16)
+
+/**
+ * @brief Room reserved at the start of static storage for the driver itself
+ *
+ */
+#define LED_STRIP_PRIV_SIZE (96)
+
+/**
+ * @brief Size of static storage for a clockless strip of n LEDs, enough for any chipset
+ *
+ */
+#define LED_STRIP_RMT_STORAGE_SIZE(n) (LED_STRIP_PRIV_SIZE + (n) * 4)
+
+/**
+ * @brief Size of static storage for a clocked strip of n LEDs, the storage must be DMA capable (DMA_ATTR)
+ *
+ */
+#define LED_STRIP_SPI_STORAGE_SIZE(n) (LED_STRIP_PRIV_SIZE + LED_STRIP_SPI_TRANSFER_SIZE(n))
+
+/**
+* @brief Install a new clockless LED strip driver (based on RMT peripheral)
+*
+* @param config: LED strip configuration, type must be one of the clockless chipsets
+*
+* @note If gpio_num is set the driver configures and installs the RMT channel in dev with mem_block_num
+*       blocks and the given interrupt flags and core, and uninstalls it again in del. Otherwise the
+*       channel must already be installed with a clock divider of 2 or more.
+*
+* @return
+*      LED strip instance or NULL
+*/
+led_strip_t *led_strip_new_rmt(const led_strip_config_t *config);
+
+/**
+* @brief Get transmit statistics of a clockless LED strip
+*
+* @param strip: LED strip created by led_strip_new_rmt()
+* @param stats: returns the statistics of the last refresh
+*
+* @return
+*      - ESP_OK: Get statistics successfully
+*      - ESP_ERR_INVALID_ARG: Get statistics failed because of invalid parameters
+*/
+esp_err_t led_strip_rmt_get_stats(led_strip_t *strip, led_strip_rmt_stats_t *stats);
+
+/**
+* @brief Called from the RMT interrupt on entering and leaving each refill
+*
+* @note Does nothing by default. Define it in IRAM elsewhere to trace the refills
+*
+* @param enter: true on entering the refill, false on leaving it
+*/
+void led_strip_rmt_isr_hook(bool enter);
+
 /**
 * @brief Install a new ws2812 driver (based on RMT peripheral)
 *
+* @note Same as led_strip_new_rmt(), kept for existing callers
+*
 * @param config: LED strip configuration
 * @return
 *      LED strip instance or NULL
 */
 led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config);
 
+/**
+* @brief Install a new APA102/SK9822 driver (based on SPI peripheral with DMA)
+*
+* @param config: LED strip configuration, dev is a spi_device_handle_t on a bus initialized with DMA
+*                and a max_transfer_sz of at least LED_STRIP_SPI_TRANSFER_SIZE(max_leds)
+* @return
+*      LED strip instance or NULL
+*/
+led_strip_t *led_strip_new_spi_apa102(const led_strip_config_t *config);
+
 #ifdef __cplusplus
 }
 #endif
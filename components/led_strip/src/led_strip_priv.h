@@ -0,0 +1,52 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+#include "led_strip.h"
+
+#define STRIP_CHECK(a, str, goto_tag, ret_value, ...)                             \
+    do                                                                            \
+    {                                                                             \
+        if (!(a))                                                                 \
+        {                                                                         \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            ret = ret_value;                                                      \
+            goto goto_tag;                                                        \
+        }                                                                         \
+    } while (0)
+
+/**
+ * @brief Byte offsets of red, green and blue within a pixel
+ *
+ */
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} led_strip_offsets_t;
+
+static inline led_strip_offsets_t led_strip_order_offsets(led_strip_order_t order)
+{
+    static const led_strip_offsets_t offsets[LED_STRIP_ORDER_MAX] = {
+        [LED_STRIP_ORDER_DEFAULT] = { 0, 1, 2 },
+        [LED_STRIP_ORDER_RGB] = { 0, 1, 2 },
+        [LED_STRIP_ORDER_RBG] = { 0, 2, 1 },
+        [LED_STRIP_ORDER_GRB] = { 1, 0, 2 },
+        [LED_STRIP_ORDER_GBR] = { 2, 0, 1 },
+        [LED_STRIP_ORDER_BRG] = { 1, 2, 0 },
+        [LED_STRIP_ORDER_BGR] = { 2, 1, 0 },
+    };
+    return offsets[order < LED_STRIP_ORDER_MAX ? order : LED_STRIP_ORDER_DEFAULT];
+}
@@ -11,44 +11,74 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/cdefs.h>
 #include "esp_log.h"
 #include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hal/cpu_hal.h"
 #include "led_strip.h"
+#include "led_strip_priv.h"
 #include "driver/rmt.h"
 
 static const char *TAG = "ws2812";
-#define STRIP_CHECK(a, str, goto_tag, ret_value, ...)                             \
-    do                                                                            \
-    {                                                                             \
-        if (!(a))                                                                 \
-        {                                                                         \
-            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
-            ret = ret_value;                                                      \
-            goto goto_tag;                                                        \
-        }                                                                         \
-    } while (0)
-
-#define WS2812_T0H_NS (350)
-#define WS2812_T0L_NS (1000)
-#define WS2812_T1H_NS (1000)
-#define WS2812_T1L_NS (350)
-#define WS2812_RESET_US (280)
-
-static uint32_t ws2812_t0h_ticks = 0;
-static uint32_t ws2812_t1h_ticks = 0;
-static uint32_t ws2812_t0l_ticks = 0;
-static uint32_t ws2812_t1l_ticks = 0;
+
+#define RMT_CLK_DIV (2)
+#define RMT_MEM_BLOCKS_MAX (8)
+
+/**
+ * @brief Bit timing and layout of a clockless chipset
+ *
+ */
+typedef struct {
+    uint16_t t0h_ns;
+    uint16_t t0l_ns;
+    uint16_t t1h_ns;
+    uint16_t t1l_ns;
+    uint8_t bytes_per_led;
+    led_strip_order_t order;
+} rmt_chipset_t;
+
+static const rmt_chipset_t rmt_chipsets[LED_STRIP_TYPE_MAX] = {
+    [LED_STRIP_WS2812] = { 350, 1000, 1000, 350, 3, LED_STRIP_ORDER_GRB },
+    [LED_STRIP_WS2811] = { 250, 1000, 600, 650, 3, LED_STRIP_ORDER_RGB },
+    [LED_STRIP_WS2815] = { 300, 1090, 1090, 320, 3, LED_STRIP_ORDER_GRB },
+    [LED_STRIP_SK6812_RGBW] = { 300, 900, 600, 600, 4, LED_STRIP_ORDER_GRB },
+};
 
 typedef struct {
     led_strip_t parent;
     rmt_channel_t rmt_channel;
     uint32_t strip_len;
+    uint8_t bytes_per_led;
+    led_strip_offsets_t offsets;
+    rmt_item32_t bit0;
+    rmt_item32_t bit1;
+    bool installed;
+    bool static_storage;
+    volatile uint32_t translator_calls;
+    volatile uint32_t translator_cycles;
+    led_strip_rmt_stats_t stats;
     uint8_t buffer[0];
 } ws2812_t;
 
+_Static_assert(sizeof(ws2812_t) <= LED_STRIP_PRIV_SIZE, "ws2812_t doesn't fit in LED_STRIP_PRIV_SIZE");
+
+typedef struct {
+    rmt_channel_t channel;
+    int intr_flags;
+    esp_err_t ret;
+    TaskHandle_t caller;
+} rmt_install_args_t;
+
+// Replaced by a strong definition to trace the refills
+void __attribute__((weak)) IRAM_ATTR led_strip_rmt_isr_hook(bool enter)
+{
+}
+
 /**
  * @brief Conver RGB data to RMT format.
  *
@@ -64,13 +94,16 @@ typedef struct {
 static void IRAM_ATTR ws2812_rmt_adapter(const void *src, rmt_item32_t *dest, size_t src_size,
         size_t wanted_num, size_t *translated_size, size_t *item_num)
 {
-    if (src == NULL || dest == NULL) {
+    ws2812_t *ws2812 = NULL;
+    if (src == NULL || dest == NULL || rmt_translator_get_context(item_num, (void **)&ws2812) != ESP_OK) {
         *translated_size = 0;
         *item_num = 0;
         return;
     }
-    const rmt_item32_t bit0 = {{{ ws2812_t0h_ticks, 1, ws2812_t0l_ticks, 0 }}}; //Logical 0
-    const rmt_item32_t bit1 = {{{ ws2812_t1h_ticks, 1, ws2812_t1l_ticks, 0 }}}; //Logical 1
+    led_strip_rmt_isr_hook(true);
+    uint32_t start = cpu_hal_get_cycle_count();
+    const rmt_item32_t bit0 = ws2812->bit0; //Logical 0
+    const rmt_item32_t bit1 = ws2812->bit1; //Logical 1
     size_t size = 0;
     size_t num = 0;
     uint8_t *psrc = (uint8_t *)src;
@@ -91,6 +124,9 @@ static void IRAM_ATTR ws2812_rmt_adapter(const void *src, rmt_item32_t *dest, si
     }
     *translated_size = size;
     *item_num = num;
+    ws2812->translator_calls++;
+    ws2812->translator_cycles += cpu_hal_get_cycle_count() - start;
+    led_strip_rmt_isr_hook(false);
 }
 
 static esp_err_t ws2812_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
@@ -98,11 +134,19 @@ static esp_err_t ws2812_set_pixel(led_strip_t *strip, uint32_t index, uint32_t r
     esp_err_t ret = ESP_OK;
     ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
     STRIP_CHECK(index < ws2812->strip_len, "index out of the maximum number of leds", err, ESP_ERR_INVALID_ARG);
-    uint32_t start = index * 3;
-    // In thr order of GRB
-    ws2812->buffer[start + 0] = green & 0xFF;
-    ws2812->buffer[start + 1] = red & 0xFF;
-    ws2812->buffer[start + 2] = blue & 0xFF;
+    uint8_t *pixel = &ws2812->buffer[index * ws2812->bytes_per_led];
+    if (ws2812->bytes_per_led == 4) {
+        // Move the common part of R,G,B to the white channel, which comes last
+        uint32_t white = red < green ? red : green;
+        white = white < blue ? white : blue;
+        red -= white;
+        green -= white;
+        blue -= white;
+        pixel[3] = white & 0xFF;
+    }
+    pixel[ws2812->offsets.r] = red & 0xFF;
+    pixel[ws2812->offsets.g] = green & 0xFF;
+    pixel[ws2812->offsets.b] = blue & 0xFF;
     return ESP_OK;
 err:
     return ret;
@@ -112,9 +156,16 @@ static esp_err_t ws2812_refresh(led_strip_t *strip, uint32_t timeout_ms)
 {
     esp_err_t ret = ESP_OK;
     ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
-    STRIP_CHECK(rmt_write_sample(ws2812->rmt_channel, ws2812->buffer, ws2812->strip_len * 3, true) == ESP_OK,
+    ws2812->translator_calls = 0;
+    ws2812->translator_cycles = 0;
+    STRIP_CHECK(rmt_write_sample(ws2812->rmt_channel, ws2812->buffer, ws2812->strip_len * ws2812->bytes_per_led, true) == ESP_OK,
                 "transmit RMT samples failed", err, ESP_FAIL);
-    return rmt_wait_tx_done(ws2812->rmt_channel, pdMS_TO_TICKS(timeout_ms));
+    ret = rmt_wait_tx_done(ws2812->rmt_channel, pdMS_TO_TICKS(timeout_ms));
+    if (ret == ESP_OK) {
+        ws2812->stats.translator_calls = ws2812->translator_calls;
+        ws2812->stats.translator_cycles = ws2812->translator_cycles;
+    }
+    return ret;
 err:
     return ret;
 }
@@ -123,42 +174,106 @@ static esp_err_t ws2812_clear(led_strip_t *strip, uint32_t timeout_ms)
 {
     ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
     // Write zero to turn off all leds
-    memset(ws2812->buffer, 0, ws2812->strip_len * 3);
+    memset(ws2812->buffer, 0, ws2812->strip_len * ws2812->bytes_per_led);
     return ws2812_refresh(strip, timeout_ms);
 }
 
 static esp_err_t ws2812_del(led_strip_t *strip)
 {
     ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
-    free(ws2812);
+    if (ws2812->installed) {
+        rmt_driver_uninstall(ws2812->rmt_channel);
+    }
+    if (!ws2812->static_storage) {
+        free(ws2812);
+    }
     return ESP_OK;
 }
 
-led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config)
+static void rmt_install_task(void *arg)
+{
+    rmt_install_args_t *args = (rmt_install_args_t *)arg;
+    args->ret = rmt_driver_install(args->channel, 0, args->intr_flags);
+    xTaskNotifyGive(args->caller);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Configure and install an RMT channel for transmitting
+ *
+ * @note The RMT interrupt is allocated on the core that installs the driver, so hop over to
+ *       a short-lived task pinned to the wanted core when it isn't this one.
+ */
+static esp_err_t rmt_install(const led_strip_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+    rmt_channel_t channel = (rmt_channel_t)config->dev;
+    rmt_config_t rmt_cfg = RMT_DEFAULT_CONFIG_TX(config->gpio_num, channel);
+    rmt_cfg.clk_div = RMT_CLK_DIV;
+    rmt_cfg.mem_block_num = config->mem_block_num;
+    STRIP_CHECK(config->mem_block_num && channel + config->mem_block_num <= RMT_MEM_BLOCKS_MAX,
+                "channel %d can't have %d memory blocks", err, ESP_ERR_INVALID_ARG, channel, config->mem_block_num);
+    STRIP_CHECK(rmt_config(&rmt_cfg) == ESP_OK, "configure rmt failed", err, ESP_FAIL);
+
+    if (config->intr_core < 0 || config->intr_core == xPortGetCoreID()) {
+        return rmt_driver_install(channel, 0, config->intr_flags);
+    }
+    rmt_install_args_t args = {
+        .channel = channel,
+        .intr_flags = config->intr_flags,
+        .ret = ESP_FAIL,
+        .caller = xTaskGetCurrentTaskHandle(),
+    };
+    STRIP_CHECK(xTaskCreatePinnedToCore(rmt_install_task, "rmt_install", 2048, &args, uxTaskPriorityGet(NULL),
+                                        NULL, config->intr_core) == pdPASS,
+                "create rmt install task failed", err, ESP_ERR_NO_MEM);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return args.ret;
+err:
+    return ret;
+}
+
+led_strip_t *led_strip_new_rmt(const led_strip_config_t *config)
 {
     led_strip_t *ret = NULL;
+    ws2812_t *ws2812 = NULL;
     STRIP_CHECK(config, "configuration can't be null", err, NULL);
+    STRIP_CHECK(config->type < LED_STRIP_TYPE_MAX && rmt_chipsets[config->type].bytes_per_led,
+                "chipset %d is not clockless", err, NULL, config->type);
+    const rmt_chipset_t *chipset = &rmt_chipsets[config->type];
+
+    // 24 or 32 bits per led
+    uint32_t ws2812_size = sizeof(ws2812_t) + config->max_leds * chipset->bytes_per_led;
+    if (config->storage) {
+        STRIP_CHECK(config->storage_size >= ws2812_size, "storage too small for ws2812", err, NULL);
+        ws2812 = memset(config->storage, 0, ws2812_size);
+        ws2812->static_storage = true;
+    } else {
+        ws2812 = calloc(1, ws2812_size);
+        STRIP_CHECK(ws2812, "request memory for ws2812 failed", err, NULL);
+    }
 
-    // 24 bits per led
-    uint32_t ws2812_size = sizeof(ws2812_t) + config->max_leds * 3;
-    ws2812_t *ws2812 = calloc(1, ws2812_size);
-    STRIP_CHECK(ws2812, "request memory for ws2812 failed", err, NULL);
+    if (config->gpio_num >= 0) {
+        STRIP_CHECK(rmt_install(config) == ESP_OK, "install rmt channel failed", err, NULL);
+        ws2812->installed = true;
+    }
 
     uint32_t counter_clk_hz = 0;
     STRIP_CHECK(rmt_get_counter_clock((rmt_channel_t)config->dev, &counter_clk_hz) == ESP_OK,
                 "get rmt counter clock failed", err, NULL);
     // ns -> ticks
     float ratio = (float)counter_clk_hz / 1e9;
-    ws2812_t0h_ticks = (uint32_t)(ratio * WS2812_T0H_NS);
-    ws2812_t0l_ticks = (uint32_t)(ratio * WS2812_T0L_NS);
-    ws2812_t1h_ticks = (uint32_t)(ratio * WS2812_T1H_NS);
-    ws2812_t1l_ticks = (uint32_t)(ratio * WS2812_T1L_NS);
+    ws2812->bit0 = (rmt_item32_t){{{ (uint32_t)(ratio * chipset->t0h_ns), 1, (uint32_t)(ratio * chipset->t0l_ns), 0 }}};
+    ws2812->bit1 = (rmt_item32_t){{{ (uint32_t)(ratio * chipset->t1h_ns), 1, (uint32_t)(ratio * chipset->t1l_ns), 0 }}};
 
     // set ws2812 to rmt adapter
     rmt_translator_init((rmt_channel_t)config->dev, ws2812_rmt_adapter);
+    rmt_translator_set_context((rmt_channel_t)config->dev, ws2812);
 
     ws2812->rmt_channel = (rmt_channel_t)config->dev;
     ws2812->strip_len = config->max_leds;
+    ws2812->bytes_per_led = chipset->bytes_per_led;
+    ws2812->offsets = led_strip_order_offsets(config->order == LED_STRIP_ORDER_DEFAULT ? chipset->order : config->order);
 
     ws2812->parent.set_pixel = ws2812_set_pixel;
     ws2812->parent.refresh = ws2812_refresh;
@@ -167,5 +282,27 @@ led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config)
 
     return &ws2812->parent;
 err:
+    if (ws2812 && ws2812->installed) {
+        rmt_driver_uninstall((rmt_channel_t)config->dev);
+    }
+    if (ws2812 && !ws2812->static_storage) {
+        free(ws2812);
+    }
     return ret;
 }
+
+esp_err_t led_strip_rmt_get_stats(led_strip_t *strip, led_strip_rmt_stats_t *stats)
+{
+    esp_err_t ret = ESP_OK;
+    STRIP_CHECK(strip && stats && strip->refresh == ws2812_refresh, "not a clockless strip", err, ESP_ERR_INVALID_ARG);
+    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    *stats = ws2812->stats;
+    return ESP_OK;
+err:
+    return ret;
+}
+
+led_strip_t *led_strip_new_rmt_ws2812(const led_strip_config_t *config)
+{
+    return led_strip_new_rmt(config);
+}
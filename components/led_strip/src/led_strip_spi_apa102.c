@@ -0,0 +1,145 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "led_strip.h"
+#include "led_strip_priv.h"
+#include "driver/spi_master.h"
+
+static const char *TAG = "apa102";
+
+#define APA102_START_SIZE (4)
+#define APA102_LED_SIZE (4)
+#define APA102_LED_HEADER (0xE0)
+#define APA102_MAX_BRIGHTNESS (0x1F)
+
+typedef struct {
+    led_strip_t parent;
+    spi_device_handle_t spi;
+    uint32_t strip_len;
+    uint32_t transfer_size;
+    led_strip_offsets_t offsets;
+    uint8_t *leds;
+    uint8_t *buffer; // DMA capable: start frame, LEDs, end frame
+    bool static_storage;
+} apa102_t;
+
+_Static_assert(sizeof(apa102_t) <= LED_STRIP_PRIV_SIZE, "apa102_t doesn't fit in LED_STRIP_PRIV_SIZE");
+
+static esp_err_t apa102_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    esp_err_t ret = ESP_OK;
+    apa102_t *apa102 = __containerof(strip, apa102_t, parent);
+    STRIP_CHECK(index < apa102->strip_len, "index out of the maximum number of leds", err, ESP_ERR_INVALID_ARG);
+    // First byte is the global brightness, the colors follow it
+    uint8_t *pixel = &apa102->leds[index * APA102_LED_SIZE + 1];
+    pixel[apa102->offsets.r] = red & 0xFF;
+    pixel[apa102->offsets.g] = green & 0xFF;
+    pixel[apa102->offsets.b] = blue & 0xFF;
+    return ESP_OK;
+err:
+    return ret;
+}
+
+static esp_err_t apa102_refresh(led_strip_t *strip, uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    apa102_t *apa102 = __containerof(strip, apa102_t, parent);
+    spi_transaction_t trans = {
+        .length = apa102->transfer_size * 8,
+        .tx_buffer = apa102->buffer,
+    };
+    spi_transaction_t *done = NULL;
+    STRIP_CHECK(spi_device_queue_trans(apa102->spi, &trans, pdMS_TO_TICKS(timeout_ms)) == ESP_OK,
+                "queue SPI transaction failed", err, ESP_FAIL);
+    // The transaction lives on the stack, so always wait for it to finish
+    return spi_device_get_trans_result(apa102->spi, &done, portMAX_DELAY);
+err:
+    return ret;
+}
+
+static esp_err_t apa102_clear(led_strip_t *strip, uint32_t timeout_ms)
+{
+    apa102_t *apa102 = __containerof(strip, apa102_t, parent);
+    for (uint32_t i = 0; i < apa102->strip_len; i++) {
+        uint8_t *led = &apa102->leds[i * APA102_LED_SIZE];
+        led[0] = APA102_LED_HEADER | APA102_MAX_BRIGHTNESS;
+        memset(&led[1], 0, APA102_LED_SIZE - 1);
+    }
+    return apa102_refresh(strip, timeout_ms);
+}
+
+static esp_err_t apa102_del(led_strip_t *strip)
+{
+    apa102_t *apa102 = __containerof(strip, apa102_t, parent);
+    if (!apa102->static_storage) {
+        heap_caps_free(apa102->buffer);
+        free(apa102);
+    }
+    return ESP_OK;
+}
+
+led_strip_t *led_strip_new_spi_apa102(const led_strip_config_t *config)
+{
+    led_strip_t *ret = NULL;
+    apa102_t *apa102 = NULL;
+    STRIP_CHECK(config, "configuration can't be null", err, NULL);
+    STRIP_CHECK(config->type == LED_STRIP_APA102 || config->type == LED_STRIP_SK9822,
+                "chipset %d is not clocked", err, NULL, config->type);
+
+    if (config->storage) {
+        STRIP_CHECK(config->storage_size >= LED_STRIP_SPI_STORAGE_SIZE(config->max_leds),
+                    "storage too small for apa102", err, NULL);
+        apa102 = memset(config->storage, 0, LED_STRIP_SPI_STORAGE_SIZE(config->max_leds));
+        apa102->static_storage = true;
+        apa102->transfer_size = LED_STRIP_SPI_TRANSFER_SIZE(config->max_leds);
+        apa102->buffer = (uint8_t *)config->storage + LED_STRIP_PRIV_SIZE;
+    } else {
+        apa102 = calloc(1, sizeof(apa102_t));
+        STRIP_CHECK(apa102, "request memory for apa102 failed", err, NULL);
+        apa102->transfer_size = LED_STRIP_SPI_TRANSFER_SIZE(config->max_leds);
+        apa102->buffer = heap_caps_calloc(1, apa102->transfer_size, MALLOC_CAP_DMA);
+        STRIP_CHECK(apa102->buffer, "request DMA memory for apa102 failed", err, NULL);
+    }
+
+    apa102->spi = (spi_device_handle_t)config->dev;
+    apa102->strip_len = config->max_leds;
+    apa102->leds = apa102->buffer + APA102_START_SIZE;
+    apa102->offsets = led_strip_order_offsets(config->order == LED_STRIP_ORDER_DEFAULT ? LED_STRIP_ORDER_BGR : config->order);
+    // Start frame is all zeros. APA102 latches on an end frame of ones, SK9822 needs zeros
+    uint8_t *end = apa102->leds + config->max_leds * APA102_LED_SIZE;
+    memset(end, config->type == LED_STRIP_APA102 ? 0xFF : 0x00, apa102->buffer + apa102->transfer_size - end);
+
+    apa102->parent.set_pixel = apa102_set_pixel;
+    apa102->parent.refresh = apa102_refresh;
+    apa102->parent.clear = apa102_clear;
+    apa102->parent.del = apa102_del;
+
+    // Full global brightness, colors are scaled by the caller
+    for (uint32_t i = 0; i < apa102->strip_len; i++) {
+        apa102->leds[i * APA102_LED_SIZE] = APA102_LED_HEADER | APA102_MAX_BRIGHTNESS;
+    }
+
+    return &apa102->parent;
+err:
+    if (apa102 && !apa102->static_storage) {
+        heap_caps_free(apa102->buffer);
+        free(apa102);
+    }
+    return ret;
+}
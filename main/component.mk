@@ -0,0 +1,6 @@
+#
+# "main" pseudo-component makefile, for the legacy make build. Everything in
+# this directory is compiled, as with COMPONENT_SRCS in CMakeLists.txt.
+#
+
+COMPONENT_ADD_INCLUDEDIRS := .
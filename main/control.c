@@ -0,0 +1,412 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "cJSON.h"
+
+#include "control.h"
+#include "leds.h"
+#include "led_patterns.h"
+#include "net.h"
+#include "palette.h"
+
+#if CONFIG_LED_CONTROL
+#define TAG "control"
+
+#define CONTROL_MAX_CLIENTS	4
+#define CONTROL_MAX_MSG		512
+#define CONTROL_TELEMETRY_MS	500
+
+/* Sent back to the client once its change is on the strip */
+typedef struct {
+	int fd;
+	int32_t id;
+	int64_t latency;
+} control_ack_t;
+
+static httpd_handle_t server = NULL;
+/* Only touched from the server task, the LED task hands latencies over with the acks */
+static int clients[CONTROL_MAX_CLIENTS] = { -1, -1, -1, -1 };
+static int64_t last_latency = 0;
+static uint32_t last_frames = 0;
+static int64_t last_frames_time = 0;
+
+static const char page[] =
+	"<!DOCTYPE html><html><head><meta name=viewport content='width=device-width'>"
+	"<title>tubalux</title><style>input,select{width:100%}</style></head><body>"
+	"<p id=stat>connecting</p><p id=lat></p>"
+	"<p>Pattern<select id=pattern></select></p>"
+	"<p>Palette<select id=palette></select></p>"
+	"<p>Hue<input type=range id=hue max=359></p>"
+	"<p>Hue 2<input type=range id=hue2 max=359></p>"
+	"<p>Intensity<input type=range id=intensity max=100></p>"
+	"<p>BPM<input type=range id=bpm min=30 max=240></p>"
+	"<script>"
+	"var ws=new WebSocket('ws://'+location.host+'/ws'),n=0,sent={};"
+	"function $(i){return document.getElementById(i)}"
+	"function send(m){m.id=++n;sent[n]=performance.now();ws.send(JSON.stringify(m))}"
+	"['hue','hue2','intensity','pattern','palette'].forEach(function(k){"
+	"$(k).oninput=function(){var m={};m[k]=+this.value;send(m)}});"
+	"$('bpm').oninput=function(){send({period_us:Math.round(6e7/this.value)})};"
+	"function fill(s,a){s.innerHTML='';a.forEach(function(t,i){s.add(new Option(t,i))})}"
+	"ws.onmessage=function(e){var m=JSON.parse(e.data);"
+	"if(m.ack){$('lat').textContent='round trip '+(performance.now()-sent[m.ack]).toFixed(1)"
+	"+' ms, on the strip after '+(m.latency_us/1000).toFixed(1)+' ms';delete sent[m.ack];return}"
+	"if(m.error){$('lat').textContent=m.error;return}"
+	"if(m.patterns){fill($('pattern'),m.patterns);fill($('palette'),m.palettes)}"
+	"['hue','hue2','intensity','palette'].forEach(function(k){if(document.activeElement!=$(k))$(k).value=m[k]});"
+	"$('pattern').value=m.layers[0];$('bpm').value=Math.round(6e7/m.period_us);"
+	"$('stat').textContent=m.fps+' fps, '+m.overruns+' overruns, '+m.heap+' bytes free'};"
+	"ws.onclose=function(){$('stat').textContent='disconnected'};"
+	"</script></body></html>";
+
+/* Patterns can also be given by name */
+static int control_find_pattern(const cJSON* item)
+{
+	if (cJSON_IsString(item)) {
+		for (int i = 0; i < LED_NUM_PATTERNS; i++) {
+			if (!strcasecmp(item->valuestring, get_patterns()[i].name)) {
+				return i;
+			}
+		}
+	}
+	/* null or an unknown name clears the layer */
+	return -1;
+}
+
+static cJSON* control_state(bool full)
+{
+	cJSON* root = cJSON_CreateObject();
+	cJSON_AddNumberToObject(root, "hue", led_get_primary_hue());
+	cJSON_AddNumberToObject(root, "hue2", led_get_secondary_hue());
+	cJSON_AddNumberToObject(root, "intensity", led_get_intensity());
+	cJSON_AddNumberToObject(root, "period_us", led_get_period_us());
+	cJSON_AddNumberToObject(root, "palette", led_get_palette_index());
+	cJSON* layers = cJSON_AddArrayToObject(root, "layers");
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		led_pattern_t* pattern = led_get_layer(l);
+		cJSON_AddItemToArray(layers, cJSON_CreateNumber(pattern ? pattern - get_patterns() : -1));
+	}
+
+	int64_t now = esp_timer_get_time();
+	uint32_t frames = led_get_frames();
+	if (last_frames_time && now > last_frames_time) {
+		cJSON_AddNumberToObject(root, "fps", (frames - last_frames) * 1000000LL / (now - last_frames_time));
+	} else {
+		cJSON_AddNumberToObject(root, "fps", 0);
+	}
+	last_frames = frames;
+	last_frames_time = now;
+	cJSON_AddNumberToObject(root, "overruns", led_get_overruns());
+	cJSON_AddNumberToObject(root, "heap", heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+	cJSON_AddNumberToObject(root, "latency_us", last_latency);
+
+	if (full) {
+		cJSON* names = cJSON_AddArrayToObject(root, "patterns");
+		for (int i = 0; i < LED_NUM_PATTERNS; i++) {
+			cJSON_AddItemToArray(names, cJSON_CreateString(get_patterns()[i].name));
+		}
+		names = cJSON_AddArrayToObject(root, "palettes");
+		for (int i = 0; i < PALETTE_NUM_GRADIENTS; i++) {
+			cJSON_AddItemToArray(names, cJSON_CreateString(get_palette_menu()[i].name));
+		}
+	}
+	return root;
+}
+
+static void control_send(int fd, cJSON* msg)
+{
+	char* text = cJSON_PrintUnformatted(msg);
+	cJSON_Delete(msg);
+	if (!text) {
+		return;
+	}
+	httpd_ws_frame_t frame = {
+		.final = true,
+		.type = HTTPD_WS_TYPE_TEXT,
+		.payload = (uint8_t*)text,
+		.len = strlen(text),
+	};
+	httpd_ws_send_frame_async(server, fd, &frame);
+	free(text);
+}
+
+static void control_send_error(int fd, int32_t id, const char* error)
+{
+	cJSON* msg = cJSON_CreateObject();
+	cJSON_AddNumberToObject(msg, "id", id);
+	cJSON_AddStringToObject(msg, "error", error);
+	control_send(fd, msg);
+}
+
+static void control_send_ack(void* arg)
+{
+	control_ack_t* ack = arg;
+	cJSON* msg = cJSON_CreateObject();
+	last_latency = ack->latency;
+	cJSON_AddNumberToObject(msg, "ack", ack->id);
+	cJSON_AddNumberToObject(msg, "latency_us", ack->latency);
+	control_send(ack->fd, msg);
+	free(ack);
+}
+
+/* Called by the LED task, hand the ack over to the server task */
+static void control_done(void* arg, int64_t latency)
+{
+	control_ack_t* ack = arg;
+	ack->latency = latency;
+	if (httpd_queue_work(server, control_send_ack, ack) != ESP_OK) {
+		free(ack);
+	}
+}
+
+/* A number from a command, false if it isn't one or is outside min - max */
+static bool control_number(const cJSON* item, int32_t min, int32_t max, int32_t* value)
+{
+	/* valuedouble, valueint saturates and would let huge values through */
+	if (!cJSON_IsNumber(item) || item->valuedouble < min || item->valuedouble > max) {
+		return false;
+	}
+	*value = item->valueint;
+	return true;
+}
+
+/*
+ * Queue every change in cmd, the last one carries done. Returns false if any
+ * value is out of the range its setter takes, in which case nothing is
+ * queued, or if the LED task is behind.
+ */
+static bool control_apply(const cJSON* cmd, int64_t time, void (*done)(void*, int64_t), void* arg)
+{
+	static const struct {
+		const char* key;
+		led_control_param_t param;
+		int32_t min, max;
+	} keys[] = {
+		{ "hue", LED_CONTROL_HUE, 0, 359 },
+		{ "hue2", LED_CONTROL_HUE2, 0, 359 },
+		{ "intensity", LED_CONTROL_INTENSITY, 0, 100 },
+		{ "period_us", LED_CONTROL_PERIOD, 1000, INT32_MAX },
+		{ "palette", LED_CONTROL_PALETTE, 0, PALETTE_NUM_GRADIENTS - 1 },
+		/* -1 clears the layer */
+		{ "pattern", LED_CONTROL_PATTERN, -1, LED_NUM_PATTERNS - 1 },
+	};
+	led_control_t ctls[sizeof(keys) / sizeof(keys[0])];
+	uint8_t num = 0;
+	const cJSON* layer = cJSON_GetObjectItem(cmd, "layer");
+	int32_t layer_index = 0;
+
+	if (layer && !control_number(layer, 0, LED_NUM_LAYERS - 1, &layer_index)) {
+		return false;
+	}
+	for (int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+		const cJSON* item = cJSON_GetObjectItem(cmd, keys[i].key);
+		if (!item) {
+			continue;
+		}
+		led_control_t* ctl = &ctls[num++];
+		memset(ctl, 0, sizeof(*ctl));
+		ctl->param = keys[i].param;
+		ctl->time = time;
+		if (keys[i].param == LED_CONTROL_PATTERN) {
+			ctl->layer = layer_index;
+			if (!cJSON_IsNumber(item)) {
+				ctl->value = control_find_pattern(item);
+				continue;
+			}
+		}
+		if (!control_number(item, keys[i].min, keys[i].max, &ctl->value)) {
+			return false;
+		}
+	}
+	if (!num) {
+		return false;
+	}
+	ctls[num - 1].done = done;
+	ctls[num - 1].arg = arg;
+	for (uint8_t i = 0; i < num; i++) {
+		if (!led_control(&ctls[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void control_hello(void* arg)
+{
+	control_send((int)(intptr_t)arg, control_state(true));
+}
+
+static esp_err_t control_ws_handler(httpd_req_t* req)
+{
+	int fd = httpd_req_to_sockfd(req);
+	if (req->method == HTTP_GET) {
+		for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+			if (clients[i] < 0) {
+				clients[i] = fd;
+				return httpd_queue_work(server, control_hello, (void*)(intptr_t)fd);
+			}
+		}
+		ESP_LOGW(TAG, "Too many clients");
+		return ESP_FAIL;
+	}
+
+	int64_t time = esp_timer_get_time();
+	uint8_t buf[CONTROL_MAX_MSG + 1];
+	httpd_ws_frame_t frame = { .payload = buf };
+	esp_err_t err = httpd_ws_recv_frame(req, &frame, CONTROL_MAX_MSG);
+	if (err != ESP_OK) {
+		return err;
+	}
+	if (frame.type != HTTPD_WS_TYPE_TEXT) {
+		return ESP_OK;
+	}
+	buf[frame.len] = '\0';
+
+	cJSON* cmd = cJSON_Parse((char*)buf);
+	const cJSON* id = cJSON_GetObjectItem(cmd, "id");
+	control_ack_t* ack = malloc(sizeof(control_ack_t));
+	if (!cmd || !ack) {
+		control_send_error(fd, 0, cmd ? "out of memory" : "bad JSON");
+		cJSON_Delete(cmd);
+		free(ack);
+		return ESP_OK;
+	}
+	ack->fd = fd;
+	ack->id = cJSON_IsNumber(id) ? id->valueint : 0;
+	if (!control_apply(cmd, time, control_done, ack)) {
+		/* If the last change didn't make it the ack won't be sent */
+		control_send_error(fd, ack->id, "not applied");
+		free(ack);
+	}
+	cJSON_Delete(cmd);
+	return ESP_OK;
+}
+
+static esp_err_t control_page_handler(httpd_req_t* req)
+{
+	httpd_resp_set_type(req, "text/html");
+	return httpd_resp_send(req, page, sizeof(page) - 1);
+}
+
+static esp_err_t control_state_handler(httpd_req_t* req)
+{
+	cJSON* state = control_state(true);
+	char* text = cJSON_PrintUnformatted(state);
+	cJSON_Delete(state);
+	if (!text) {
+		return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "out of memory");
+	}
+	httpd_resp_set_type(req, "application/json");
+	esp_err_t err = httpd_resp_sendstr(req, text);
+	free(text);
+	return err;
+}
+
+static esp_err_t control_set_handler(httpd_req_t* req)
+{
+	char buf[CONTROL_MAX_MSG + 1];
+	int len = 0;
+	if (req->content_len > CONTROL_MAX_MSG) {
+		return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "too long");
+	}
+	while (len < req->content_len) {
+		int ret = httpd_req_recv(req, buf + len, req->content_len - len);
+		if (ret <= 0) {
+			return ESP_FAIL;
+		}
+		len += ret;
+	}
+	buf[len] = '\0';
+
+	cJSON* cmd = cJSON_Parse(buf);
+	bool ok = cmd && control_apply(cmd, esp_timer_get_time(), NULL, NULL);
+	cJSON_Delete(cmd);
+	if (!ok) {
+		return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "not applied");
+	}
+	return httpd_resp_sendstr(req, "{}");
+}
+
+/* Controls are tiny, don't let Nagle hold them back */
+static esp_err_t control_open(httpd_handle_t hd, int fd)
+{
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return ESP_OK;
+}
+
+static void control_close(httpd_handle_t hd, int fd)
+{
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (clients[i] == fd) {
+			clients[i] = -1;
+		}
+	}
+	close(fd);
+}
+
+static void control_telemetry(void* arg)
+{
+	cJSON* state = control_state(false);
+	char* text = cJSON_PrintUnformatted(state);
+	cJSON_Delete(state);
+	if (!text) {
+		return;
+	}
+	httpd_ws_frame_t frame = {
+		.final = true,
+		.type = HTTPD_WS_TYPE_TEXT,
+		.payload = (uint8_t*)text,
+		.len = strlen(text),
+	};
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (clients[i] >= 0) {
+			httpd_ws_send_frame_async(server, clients[i], &frame);
+		}
+	}
+	free(text);
+}
+
+static void control_telemetry_timer(void* arg)
+{
+	httpd_queue_work(server, control_telemetry, NULL);
+}
+
+void control_init()
+{
+	net_init(CONFIG_LED_WIFI_CHANNEL);
+
+	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+	config.max_open_sockets = CONTROL_MAX_CLIENTS + 1;
+	config.lru_purge_enable = true;
+	config.open_fn = control_open;
+	config.close_fn = control_close;
+	ESP_ERROR_CHECK(httpd_start(&server, &config));
+
+	static const httpd_uri_t uris[] = {
+		{ .uri = "/", .method = HTTP_GET, .handler = control_page_handler },
+		{ .uri = "/ws", .method = HTTP_GET, .handler = control_ws_handler, .is_websocket = true },
+		{ .uri = "/api/state", .method = HTTP_GET, .handler = control_state_handler },
+		{ .uri = "/api/set", .method = HTTP_POST, .handler = control_set_handler },
+	};
+	for (int i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+		ESP_ERROR_CHECK(httpd_register_uri_handler(server, &uris[i]));
+	}
+
+	esp_timer_handle_t timer;
+	esp_timer_create_args_t timer_args = {
+		.callback = control_telemetry_timer,
+		.name = "control",
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
+	ESP_ERROR_CHECK(esp_timer_start_periodic(timer, CONTROL_TELEMETRY_MS * 1000));
+	ESP_LOGI(TAG, "Control on http://<unit>/ (SSID %s)", CONFIG_LED_CONTROL_SSID);
+}
+#endif /* CONFIG_LED_CONTROL */
@@ -0,0 +1,18 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+/*
+ * HTTP and WebSocket control on the Wi-Fi access point. GET / serves a page
+ * with knobs, /ws takes JSON commands like
+ *	{"id": 7, "hue": 120, "intensity": 80, "pattern": "Plasma", "layer": 1}
+ * and answers {"ack": 7, "latency_us": N} once a frame with the change is on
+ * the strip, N counting from when the message arrived. A command with any
+ * value out of range (hue 0-359, intensity 0-100, period_us from 1000) is
+ * dropped whole and answered with {"id": 7, "error": "not applied"}. Every
+ * client also gets the state a few times a second. GET /api/state and POST
+ * /api/set do the same without a socket. Layers 0 to LED_NUM_ZONES - 1 are
+ * the zones, the ones above are overlays.
+ */
+void control_init(void);
+
+#endif /* CONTROL_H */
@@ -0,0 +1,156 @@
+#ifndef FIXED_H
+#define FIXED_H
+#include <stdint.h>
+
+/*
+ * 8 and 16-bit fixed point for pattern code, so pixel loops need no float
+ * or division. Fractions are 0-255 (or 0-65535) for 0 to 1, and scaling by
+ * the largest fraction leaves a value unchanged. Angles are 0-255 (or
+ * 0-65535) for a whole turn.
+ */
+
+extern const uint8_t fixed_sin8_table[256];
+extern const int16_t fixed_sin16_quarter[257];
+
+/* x * scale / 256, with scale8(x, 255) == x */
+static inline uint8_t scale8(uint8_t x, uint8_t scale)
+{
+	return (x * (scale + 1)) >> 8;
+}
+
+/* Like scale8, but a lit value never scales down to off */
+static inline uint8_t scale8_video(uint8_t x, uint8_t scale)
+{
+	return ((x * scale) >> 8) + (x && scale);
+}
+
+static inline uint16_t scale16(uint16_t x, uint16_t scale)
+{
+	return ((uint32_t)x * (scale + 1)) >> 16;
+}
+
+static inline uint16_t scale16by8(uint16_t x, uint8_t scale)
+{
+	return ((uint32_t)x * (scale + 1)) >> 8;
+}
+
+/* Percent, as used by the intensity and saturation settings, to 0-255 */
+static inline uint8_t percent8(uint8_t percent)
+{
+	return (percent >= 100) ? 255 : (percent * 167117) >> 16;
+}
+
+/* Saturating add and subtract */
+static inline uint8_t qadd8(uint8_t a, uint8_t b)
+{
+	uint32_t sum = a + b;
+	return (sum > 255) ? 255 : sum;
+}
+
+static inline uint8_t qsub8(uint8_t a, uint8_t b)
+{
+	return (a > b) ? a - b : 0;
+}
+
+static inline uint16_t qadd16(uint16_t a, uint16_t b)
+{
+	uint32_t sum = a + b;
+	return (sum > 65535) ? 65535 : sum;
+}
+
+static inline uint16_t qsub16(uint16_t a, uint16_t b)
+{
+	return (a > b) ? a - b : 0;
+}
+
+/* From a towards b by frac, lerp8(a, b, 255) == b */
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint8_t frac)
+{
+	return (b > a) ? a + scale8(b - a, frac) : a - scale8(a - b, frac);
+}
+
+static inline uint16_t lerp16(uint16_t a, uint16_t b, uint16_t frac)
+{
+	return (b > a) ? a + scale16(b - a, frac) : a - scale16(a - b, frac);
+}
+
+/* 128 + 127.5 * sin rounded down, from a table */
+static inline uint8_t sin8(uint8_t theta)
+{
+	return fixed_sin8_table[theta];
+}
+
+static inline uint8_t cos8(uint8_t theta)
+{
+	return fixed_sin8_table[(uint8_t)(theta + 64)];
+}
+
+/* 32767 * sin, from a quarter wave table with linear interpolation */
+static inline int16_t sin16(uint16_t theta)
+{
+	uint16_t quarter = theta & 0x3fff;
+	if (theta & 0x4000) {
+		quarter = 0x4000 - quarter;
+	}
+	uint16_t i = quarter >> 6;
+	int32_t a = fixed_sin16_quarter[i];
+	int32_t b = fixed_sin16_quarter[(i < 256) ? i + 1 : 256];
+	int16_t y = a + (((b - a) * (quarter & 0x3f)) >> 6);
+	return (theta & 0x8000) ? -y : y;
+}
+
+static inline int16_t cos16(uint16_t theta)
+{
+	return sin16(theta + 0x4000);
+}
+
+/* Ease curves, 0 and 255 map to themselves */
+static inline uint8_t ease8_in_quad(uint8_t t)
+{
+	return scale8(t, t);
+}
+
+static inline uint8_t ease8_out_quad(uint8_t t)
+{
+	return 255 - scale8(255 - t, 255 - t);
+}
+
+static inline uint8_t ease8_in_out_quad(uint8_t t)
+{
+	uint8_t half = (t & 0x80) ? 255 - t : t;
+	uint8_t y = scale8(half, half) << 1;
+	return (t & 0x80) ? 255 - y : y;
+}
+
+/* Smoothstep, 3t^2 - 2t^3 */
+static inline uint8_t ease8_in_out_cubic(uint8_t t)
+{
+	return (t * t * (768 - 2 * t)) >> 16;
+}
+
+/* Roughly gamma 2, dim8 darkens the low end and brighten8 lifts it */
+static inline uint8_t dim8_raw(uint8_t x)
+{
+	return scale8(x, x);
+}
+
+static inline uint8_t dim8_video(uint8_t x)
+{
+	return scale8_video(x, x);
+}
+
+static inline uint8_t brighten8_raw(uint8_t x)
+{
+	return 255 - dim8_raw(255 - x);
+}
+
+static inline uint8_t brighten8_video(uint8_t x)
+{
+	return 255 - dim8_video(255 - x);
+}
+
+#if CONFIG_LED_FIXED_BENCHMARK
+void fixed_benchmark(void);
+#endif
+
+#endif /* FIXED_H */
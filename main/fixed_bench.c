@@ -0,0 +1,49 @@
+#include <stdint.h>
+#include "esp_log.h"
+#include "hal/cpu_hal.h"
+
+#include "fixed.h"
+#include "leds.h"
+
+#define TAG "fixed"
+
+#define FIXED_BENCH_ITERATIONS	4096
+
+#if CONFIG_LED_FIXED_BENCHMARK
+/* The sink keeps the compiler from dropping the loops */
+static volatile uint32_t sink;
+
+#define FIXED_BENCH(name, expr) do {						\
+	uint32_t acc = 0;							\
+	uint32_t start = cpu_hal_get_cycle_count();				\
+	for (uint32_t i = 0; i < FIXED_BENCH_ITERATIONS; i++) {			\
+		acc += (expr);							\
+	}									\
+	uint32_t cycles = cpu_hal_get_cycle_count() - start;			\
+	sink = acc;								\
+	ESP_LOGI(TAG, "%-20s %4u.%02u cycles", name,				\
+		 cycles / FIXED_BENCH_ITERATIONS,				\
+		 (cycles % FIXED_BENCH_ITERATIONS) * 100 / FIXED_BENCH_ITERATIONS);	\
+} while (0)
+
+/* Cycles per call of each primitive, loop overhead included */
+void fixed_benchmark()
+{
+	uint8_t r, g, b;
+	FIXED_BENCH("loop", i);
+	FIXED_BENCH("scale8", scale8(i, i >> 4));
+	FIXED_BENCH("scale8_video", scale8_video(i, i >> 4));
+	FIXED_BENCH("scale16", scale16(i * 17, i * 13));
+	FIXED_BENCH("qadd8", qadd8(i, i >> 3));
+	FIXED_BENCH("qsub8", qsub8(i, i >> 3));
+	FIXED_BENCH("lerp8", lerp8(i, i >> 4, i >> 2));
+	FIXED_BENCH("lerp16", lerp16(i * 17, i * 5, i * 13));
+	FIXED_BENCH("sin8", sin8(i));
+	FIXED_BENCH("sin16", sin16(i * 16));
+	FIXED_BENCH("ease8_in_out_quad", ease8_in_out_quad(i));
+	FIXED_BENCH("ease8_in_out_cubic", ease8_in_out_cubic(i));
+	FIXED_BENCH("dim8_video", dim8_video(i));
+	FIXED_BENCH("brighten8_video", brighten8_video(i));
+	FIXED_BENCH("hsv2rgb", (led_strip_hsv2rgb(i % 360, 100, 42, &r, &g, &b), r + g + b));
+}
+#endif
@@ -0,0 +1,90 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "latency.h"
+#include "sysmon.h"
+#include "ui_buttons.h"
+
+#if CONFIG_LED_LATENCY
+#define TAG "latency"
+
+#define LATENCY_TASK_STACK	2048
+#define LATENCY_PROBES		16
+/* A probe that hasn't reached the strip by then never will, e.g. a press that only changed screens */
+#define LATENCY_TIMEOUT_US	2000000
+#define LATENCY_INJECT_START_MS	3000
+
+static int64_t probe[LATENCY_NUM_STAGES];
+static uint8_t next_stage = LATENCY_NUM_STAGES;
+/* Finished probes for the task to print, so the LED task never waits on the console */
+static int64_t done[LATENCY_PROBES][LATENCY_NUM_STAGES];
+static uint32_t done_head = 0;
+static uint32_t done_tail = 0;
+static portMUX_TYPE latency_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t latency_task;
+
+/* Called from tasks and the button interrupts */
+void IRAM_ATTR latency_mark(latency_stage_t stage)
+{
+	int64_t now = esp_timer_get_time();
+	portENTER_CRITICAL_SAFE(&latency_mux);
+	if (stage == LATENCY_PRESS) {
+		/* Presses while a probe is on its way only count once it has timed out */
+		if (next_stage == LATENCY_NUM_STAGES || now - probe[LATENCY_PRESS] > LATENCY_TIMEOUT_US) {
+			probe[LATENCY_PRESS] = now;
+			next_stage = LATENCY_DEBOUNCED;
+		}
+	} else if (stage == next_stage) {
+		probe[next_stage++] = now;
+		if (next_stage == LATENCY_NUM_STAGES && done_head - done_tail < LATENCY_PROBES) {
+			memcpy(done[done_head++ % LATENCY_PROBES], probe, sizeof(probe));
+		}
+	}
+	portEXIT_CRITICAL_SAFE(&latency_mux);
+}
+
+/*
+ * Prints the finished probes and, with CONFIG_LED_LATENCY_INJECT_MS, presses
+ * buttons itself: up opens the colour screen from idle, then right and left
+ * nudge the hue back and forth.
+ */
+static void latency_loop(void* parameters)
+{
+#if CONFIG_LED_LATENCY_INJECT_MS
+	uint32_t presses = 0;
+	vTaskDelay(pdMS_TO_TICKS(LATENCY_INJECT_START_MS));
+#endif
+	while (true) {
+#if CONFIG_LED_LATENCY_INJECT_MS
+		ui_buttons_inject(presses ? ((presses & 1) ? UI_BTN_R : UI_BTN_L) : UI_BTN_UP);
+		presses++;
+		vTaskDelay(pdMS_TO_TICKS(CONFIG_LED_LATENCY_INJECT_MS));
+#else
+		vTaskDelay(pdMS_TO_TICKS(1000));
+#endif
+		while (done_tail != done_head) {
+			const int64_t* p = done[done_tail % LATENCY_PROBES];
+			printf("LATENCY");
+			for (uint8_t s = LATENCY_DEBOUNCED; s < LATENCY_NUM_STAGES; s++) {
+				printf(" %lld", p[s] - p[LATENCY_PRESS]);
+			}
+			printf("\n");
+			portENTER_CRITICAL(&latency_mux);
+			done_tail++;
+			portEXIT_CRITICAL(&latency_mux);
+		}
+	}
+}
+
+void latency_init()
+{
+	SYSMON_TASK_CREATE(latency_loop, "latency", LATENCY_TASK_STACK, NULL, 1, &latency_task, tskNO_AFFINITY);
+}
+#endif
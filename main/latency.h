@@ -0,0 +1,31 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+#include <stdint.h>
+
+/*
+ * Button to light latency. A press starts a probe and each stage it passes
+ * on the way to the strip is timestamped once, in order. Finished probes
+ * are printed as LATENCY lines with each stage in us since the press, for
+ * tools/latency_report.py. The marks compile to nothing without
+ * CONFIG_LED_LATENCY.
+ */
+typedef enum {
+	LATENCY_PRESS,		/* button interrupt, or an injected press */
+	LATENCY_DEBOUNCED,	/* debounce task hands it to the UI */
+	LATENCY_UI,		/* UI task wakes up with it */
+	LATENCY_APPLIED,	/* a setter changes what the LEDs show */
+	LATENCY_RENDERED,	/* LED task renders with the change */
+	LATENCY_LIT,		/* a frame with it is on the strip */
+	LATENCY_NUM_STAGES
+} latency_stage_t;
+
+#if CONFIG_LED_LATENCY
+#define LATENCY_MARK(stage)	latency_mark(stage)
+#else
+#define LATENCY_MARK(stage)
+#endif
+
+void latency_mark(latency_stage_t stage);
+void latency_init(void);
+
+#endif /* LATENCY_H */
@@ -0,0 +1,33 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "led_dither.h"
+
+void led_dither_seed(uint8_t* err, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++) {
+		/* Odd, so any 256 channels in a row start at every phase once */
+		err[i] = (i * 97) & 0xff;
+	}
+}
+
+void led_dither_expand(uint16_t* deep, const uint8_t* src, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++) {
+		deep[i] = src[i] << 8;
+	}
+}
+
+bool led_dither_quantise(uint8_t* dst, const uint16_t* deep, uint8_t* err, uint32_t len, uint32_t level)
+{
+	uint32_t frac = 0;
+	for (uint32_t i = 0; i < len; i++) {
+		/* At most 0xff00 + 0xff, so never more than 255 out */
+		uint32_t v = ((uint32_t)deep[i] * level) >> 16;
+		uint32_t s = v + err[i];
+		dst[i] = s >> 8;
+		err[i] = s;
+		frac |= v;
+	}
+	return frac & 0xff;
+}
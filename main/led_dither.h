@@ -0,0 +1,24 @@
+#ifndef LED_DITHER_H
+#define LED_DITHER_H
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Frames kept at 16 bits per channel, in 8.8 fixed point so 255 << 8 is
+ * full, and brought down to the strip's 8 bits a refresh at a time. Each
+ * channel carries what it rounded off into the next refresh, so over a few
+ * refreshes it averages out at the 16-bit value. Functions work on runs of
+ * channels, three per pixel.
+ */
+#define LED_DITHER_LEVEL_MAX	65536
+
+/* Stagger the carried errors so neighbouring pixels don't step up together */
+void led_dither_seed(uint8_t* err, uint32_t len);
+void led_dither_expand(uint16_t* deep, const uint8_t* src, uint32_t len);
+/*
+ * Scale deep by level (0 - LED_DITHER_LEVEL_MAX) into dst. Returns false if
+ * every channel came out exact, then refreshing again shows nothing new.
+ */
+bool led_dither_quantise(uint8_t* dst, const uint16_t* deep, uint8_t* err, uint32_t len, uint32_t level);
+
+#endif /* LED_DITHER_H */
@@ -0,0 +1,68 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "led_frame.h"
+
+/* Pixels moved through the stack at a time */
+#define LED_FRAME_ROTATE_BUF	16
+
+/* Swap two spans that don't overlap, a buffer's worth at a time */
+static void led_frame_swap(led_rgb_t* a, led_rgb_t* b, uint32_t len)
+{
+	led_rgb_t buf[LED_FRAME_ROTATE_BUF];
+	while (len) {
+		uint32_t n = (len < LED_FRAME_ROTATE_BUF) ? len : LED_FRAME_ROTATE_BUF;
+		memcpy(buf, a, n * sizeof(led_rgb_t));
+		memcpy(a, b, n * sizeof(led_rgb_t));
+		memcpy(b, buf, n * sizeof(led_rgb_t));
+		a += n;
+		b += n;
+		len -= n;
+	}
+}
+
+/*
+ * Swap the shorter of the two parts into place and carry on with what is
+ * left, until one part fits in the buffer and a single memmove finishes it.
+ * Every pixel is copied about three times, all of it with memcpy.
+ */
+void led_frame_rotate(led_frame_t* frame, int32_t n)
+{
+	led_rgb_t* p = frame->pixels;
+	uint32_t num = frame->num;
+	led_rgb_t buf[LED_FRAME_ROTATE_BUF];
+	if (num < 2) {
+		return;
+	}
+	n %= (int32_t)num;
+	if (n < 0) {
+		n += num;
+	}
+	/* The last n pixels go to the front, ahead of the first left */
+	uint32_t right = n;
+	uint32_t left = num - n;
+	while (right && left) {
+		if (right <= LED_FRAME_ROTATE_BUF) {
+			memcpy(buf, &p[left], right * sizeof(led_rgb_t));
+			memmove(&p[right], p, left * sizeof(led_rgb_t));
+			memcpy(p, buf, right * sizeof(led_rgb_t));
+			return;
+		}
+		if (left <= LED_FRAME_ROTATE_BUF) {
+			memcpy(buf, p, left * sizeof(led_rgb_t));
+			memmove(p, &p[left], right * sizeof(led_rgb_t));
+			memcpy(&p[right], buf, left * sizeof(led_rgb_t));
+			return;
+		}
+		if (right <= left) {
+			/* The right part swaps with the start of the left one, which then still has to rotate */
+			led_frame_swap(p, &p[left], right);
+			p += right;
+			left -= right;
+		} else {
+			/* The left part swaps with the end of the right one, and the right part rotates on */
+			led_frame_swap(p, &p[right], left);
+			right -= left;
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef LED_FRAME_H
+#define LED_FRAME_H
+#include <stdint.h>
+#include <string.h>
+
+#include "fixed.h"
+
+typedef struct {
+	uint8_t r, g, b;
+} led_rgb_t;
+
+/* A run of RGB pixels that a pattern renders into */
+typedef struct {
+	led_rgb_t* pixels;
+	uint32_t num;
+} led_frame_t;
+
+static inline void led_frame_clear(led_frame_t* frame)
+{
+	memset(frame->pixels, 0, frame->num * sizeof(led_rgb_t));
+}
+
+/* Doubles the filled span with each copy */
+static inline void led_frame_fill(led_frame_t* frame, led_rgb_t color)
+{
+	if (!frame->num) {
+		return;
+	}
+	frame->pixels[0] = color;
+	for (uint32_t done = 1; done < frame->num; done <<= 1) {
+		uint32_t len = (done < frame->num - done) ? done : frame->num - done;
+		memcpy(&frame->pixels[done], frame->pixels, len * sizeof(led_rgb_t));
+	}
+}
+
+/*
+ * Whole-frame rotation, so patterns that scroll can render once and then
+ * move the pixels along. Positive n moves pixel i to i + n.
+ */
+void led_frame_rotate(led_frame_t* frame, int32_t n);
+
+static inline led_rgb_t led_rgb_scale(led_rgb_t c, uint8_t scale)
+{
+	return (led_rgb_t) { scale8(c.r, scale), scale8(c.g, scale), scale8(c.b, scale) };
+}
+
+/* Scale without turning any lit channel off */
+static inline led_rgb_t led_rgb_scale_video(led_rgb_t c, uint8_t scale)
+{
+	return (led_rgb_t) { scale8_video(c.r, scale), scale8_video(c.g, scale), scale8_video(c.b, scale) };
+}
+
+#endif /* LED_FRAME_H */
@@ -0,0 +1,346 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#include "fixed.h"
+#include "led_layers.h"
+
+#define TAG "LED_layers"
+
+#define LED_LAYER_MIN_STEP	1000		/* us */
+#define LED_DEGRADE_US		1000000
+
+typedef struct {
+	led_pattern_t* pattern;
+	void* state;
+	led_frame_t frame;
+	led_span_t span;
+	led_blend_t blend;
+	uint8_t opacity;
+	int64_t next;		/* us, deadlines add up so they never drift */
+	int64_t shift;		/* clock jumps not yet applied to next, under layers_mux */
+	/* Changes are handed over to the LED task under layers_mux, it owns the rest */
+	led_layer_params_t requested;
+	bool changed;
+} led_layer_t;
+
+static led_layer_t layers[LED_NUM_LAYERS];
+static portMUX_TYPE layers_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t overruns = 0;
+#if CONFIG_LED_OVERRUN_DEGRADE
+static int64_t degraded_until = 0;
+#endif
+#if CONFIG_LED_STATIC_ALLOC
+static led_rgb_t layer_pixels[LED_NUM_LAYERS * CONFIG_NUM_LEDS];
+static uint32_t layer_state[LED_NUM_LAYERS][LED_LAYER_STATE_MAX / sizeof(uint32_t)];
+#endif
+
+/*
+ * Lay the zones out from a list of lengths such as "30,30r,60m", where r
+ * reverses a zone and m mirrors it. An empty layout shares the strip out
+ * evenly. The zones have to add up to the whole strip.
+ */
+bool led_zones_parse(const char* layout, uint32_t num, led_span_t* spans)
+{
+	uint32_t offset = 0;
+	for (uint8_t z = 0; z < LED_NUM_ZONES; z++) {
+		spans[z] = (led_span_t) { .offset = offset };
+		if (!*layout) {
+			/* The first zones take the leftover LEDs */
+			spans[z].num = num / LED_NUM_ZONES + (z < num % LED_NUM_ZONES);
+		} else {
+			char* end;
+			spans[z].num = strtoul(layout, &end, 10);
+			if (end == layout || !spans[z].num) {
+				return false;
+			}
+			for (; *end == 'r' || *end == 'm'; end++) {
+				spans[z].reverse |= (*end == 'r');
+				spans[z].mirror |= (*end == 'm');
+			}
+			if (*end != ((z == LED_NUM_ZONES - 1) ? '\0' : ',')) {
+				return false;
+			}
+			layout = (*end) ? end + 1 : end;
+		}
+		offset += spans[z].num;
+	}
+	return offset == num;
+}
+
+void led_layers_init(uint32_t num)
+{
+	led_span_t spans[LED_NUM_ZONES];
+#ifdef CONFIG_LED_ZONE_LAYOUT
+	const char* layout = CONFIG_LED_ZONE_LAYOUT;
+#else
+	const char* layout = "";
+#endif
+#if CONFIG_LED_STATIC_ALLOC
+	led_rgb_t* pixels = layer_pixels;
+	ESP_ERROR_CHECK(num <= CONFIG_NUM_LEDS ? ESP_OK : ESP_ERR_NO_MEM);
+#else
+	led_rgb_t* pixels = calloc(LED_NUM_LAYERS * num, sizeof(led_rgb_t));
+	ESP_ERROR_CHECK(pixels ? ESP_OK : ESP_ERR_NO_MEM);
+#endif
+	if (!led_zones_parse(layout, num, spans)) {
+		ESP_LOGE(TAG, "Zone layout \"%s\" doesn't fit %u zones over %u LEDs", layout, LED_NUM_ZONES, num);
+		ESP_ERROR_CHECK(ESP_ERR_INVALID_ARG);
+	}
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		layers[l].span = (l < LED_NUM_ZONES) ? spans[l] : (led_span_t) { .num = num };
+		layers[l].frame.pixels = &pixels[l * num];
+		layers[l].frame.num = layers[l].span.mirror ? (layers[l].span.num + 1) / 2 : layers[l].span.num;
+		layers[l].blend = LED_BLEND_ALPHA;
+		layers[l].opacity = 255;
+		layers[l].requested.blend = LED_BLEND_ALPHA;
+		layers[l].requested.opacity = 255;
+	}
+}
+
+void led_layer_set(uint8_t layer, const led_layer_params_t* params)
+{
+	if (layer >= LED_NUM_LAYERS || params->blend >= LED_BLEND_NUM) {
+		return;
+	}
+	portENTER_CRITICAL(&layers_mux);
+	layers[layer].requested = *params;
+	layers[layer].changed = true;
+	portEXIT_CRITICAL(&layers_mux);
+}
+
+void led_zone_get_span(uint8_t zone, led_span_t* span)
+{
+	*span = (zone < LED_NUM_ZONES) ? layers[zone].span : (led_span_t) { .num = 0 };
+}
+
+/* The last parameters set, which may not have started yet */
+void led_layer_get(uint8_t layer, led_layer_params_t* params)
+{
+	if (layer >= LED_NUM_LAYERS) {
+		*params = (led_layer_params_t) { .pattern = NULL };
+		return;
+	}
+	portENTER_CRITICAL(&layers_mux);
+	*params = layers[layer].requested;
+	portEXIT_CRITICAL(&layers_mux);
+}
+
+static void led_layer_start(led_layer_t* layer, const led_layer_params_t* params)
+{
+#if !CONFIG_LED_STATIC_ALLOC
+	free(layer->state);
+#endif
+	layer->state = NULL;
+	layer->pattern = params->pattern;
+	layer->blend = params->blend;
+	layer->opacity = params->opacity;
+	led_frame_clear(&layer->frame);
+	if (!layer->pattern) {
+		return;
+	}
+	ESP_LOGD(TAG, "Starting pattern %s on layer %u", layer->pattern->name, layer - layers);
+	if (layer->pattern->state_size) {
+#if CONFIG_LED_STATIC_ALLOC
+		if (layer->pattern->state_size <= LED_LAYER_STATE_MAX) {
+			layer->state = memset(layer_state[layer - layers], 0, layer->pattern->state_size);
+		}
+#else
+		layer->state = calloc(1, layer->pattern->state_size);
+#endif
+		if (!layer->state) {
+			ESP_LOGE(TAG, "No memory for pattern %s", layer->pattern->name);
+			layer->pattern = NULL;
+			return;
+		}
+	}
+	if (layer->pattern->init) {
+		layer->pattern->init(&layer->frame, layer->state);
+	}
+	/* From the requested start rather than now, so units sharing a clock line up */
+	layer->next = params->start;
+}
+
+/* Called when a layer is already due again after rendering, i.e. it missed a whole step */
+static void led_layer_overrun(led_layer_t* layer, int64_t now, uint32_t step)
+{
+	overruns++;
+	ESP_LOGD(TAG, "Layer %u overran by %lld us", layer - layers, now - layer->next);
+#if CONFIG_LED_OVERRUN_SLIP
+	/* Start over from now, the pattern falls behind the clock */
+	layer->next = now + step;
+#else
+	/* Drop the missed steps, the pattern stays in phase with the clock */
+	layer->next += ((now - layer->next) / step + 1) * step;
+#endif
+#if CONFIG_LED_OVERRUN_DEGRADE
+	/* and give the zones the CPU for a while */
+	degraded_until = now + LED_DEGRADE_US;
+#endif
+}
+
+/*
+ * Render every layer that is due. Returns true if any layer changed, and the
+ * time the next layer is due in next, or INT64_MAX if there is none.
+ */
+bool led_layers_render(int64_t now, int64_t* next)
+{
+	bool rendered = false;
+	int64_t soonest = INT64_MAX;
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		led_layer_t* layer = &layers[l];
+		led_layer_params_t params;
+		bool start = false;
+		portENTER_CRITICAL(&layers_mux);
+		layer->next += layer->shift;
+		layer->shift = 0;
+		if (layer->changed && now >= layer->requested.start) {
+			layer->changed = false;
+			params = layer->requested;
+			start = true;
+		} else if (layer->changed && layer->requested.start < soonest) {
+			soonest = layer->requested.start;
+		}
+		portEXIT_CRITICAL(&layers_mux);
+		if (start) {
+			led_layer_start(layer, &params);
+			rendered = true;
+		}
+		if (!layer->pattern) {
+			continue;
+		}
+		if (now >= layer->next) {
+			uint32_t step = layer->pattern->render(&layer->frame, layer->state);
+			step = (step < LED_LAYER_MIN_STEP) ? LED_LAYER_MIN_STEP : step;
+#if CONFIG_LED_OVERRUN_DEGRADE
+			/* Overlays run at half rate while degraded, the zones keep theirs */
+			if (l >= LED_NUM_ZONES && now < degraded_until) {
+				step *= 2;
+			}
+#endif
+			layer->next += step;
+			if (now >= layer->next) {
+				led_layer_overrun(layer, now, step);
+			}
+			rendered = true;
+		}
+		if (layer->next < soonest) {
+			soonest = layer->next;
+		}
+	}
+	*next = soonest;
+	return rendered;
+}
+
+/*
+ * Move every deadline when the clock jumps, so running patterns carry on
+ * smoothly. Call it as the clock jumps: starts set after that are already on
+ * the new clock. Running layers pick it up on their next render.
+ */
+void led_layers_shift(int64_t delta)
+{
+	portENTER_CRITICAL(&layers_mux);
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		layers[l].shift += delta;
+		layers[l].requested.start += delta;
+	}
+	portEXIT_CRITICAL(&layers_mux);
+}
+
+/* Blend one pixel of a layer onto what is below it with saturating math */
+static inline void led_blend(int32_t* r, int32_t* g, int32_t* b, const led_rgb_t* src, int32_t op, led_blend_t blend)
+{
+	int32_t sr, sg, sb;
+	switch (blend) {
+	case LED_BLEND_ALPHA:
+		*r += ((src->r - *r) * (op + 1)) >> 8;
+		*g += ((src->g - *g) * (op + 1)) >> 8;
+		*b += ((src->b - *b) * (op + 1)) >> 8;
+		break;
+	case LED_BLEND_ADD:
+		*r = qadd8(*r, scale8(src->r, op));
+		*g = qadd8(*g, scale8(src->g, op));
+		*b = qadd8(*b, scale8(src->b, op));
+		break;
+	case LED_BLEND_SCREEN:
+		sr = scale8(src->r, op);
+		sg = scale8(src->g, op);
+		sb = scale8(src->b, op);
+		*r += sr - scale8(*r, sr);
+		*g += sg - scale8(*g, sg);
+		*b += sb - scale8(*b, sb);
+		break;
+	case LED_BLEND_MULTIPLY:
+		*r += ((scale8(*r, src->r) - *r) * (op + 1)) >> 8;
+		*g += ((scale8(*g, src->g) - *g) * (op + 1)) >> 8;
+		*b += ((scale8(*b, src->b) - *b) * (op + 1)) >> 8;
+		break;
+	case LED_BLEND_MAX:
+		sr = scale8(src->r, op);
+		sg = scale8(src->g, op);
+		sb = scale8(src->b, op);
+		*r = (sr > *r) ? sr : *r;
+		*g = (sg > *g) ? sg : *g;
+		*b = (sb > *b) ? sb : *b;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Put a zone into its span of the output, over black */
+static void led_zone_composite(const led_layer_t* zone, led_frame_t* out)
+{
+	const led_span_t* span = &zone->span;
+	led_rgb_t* dst = &out->pixels[span->offset];
+	if (!zone->pattern || !zone->opacity) {
+		memset(dst, 0, span->num * sizeof(led_rgb_t));
+		return;
+	}
+	if (!span->reverse && !span->mirror && zone->blend == LED_BLEND_ALPHA && zone->opacity == 255) {
+		memcpy(dst, zone->frame.pixels, span->num * sizeof(led_rgb_t));
+		return;
+	}
+	for (uint32_t i = 0; i < span->num; i++) {
+		uint32_t j = span->reverse ? span->num - 1 - i : i;
+		if (j >= zone->frame.num) {
+			j = span->num - 1 - j;
+		}
+		int32_t r = 0, g = 0, b = 0;
+		led_blend(&r, &g, &b, &zone->frame.pixels[j], zone->opacity, zone->blend);
+		dst[i] = (led_rgb_t) { r, g, b };
+	}
+}
+
+/* The zones go straight into the output, then one pass takes each pixel through the overlays */
+void led_layers_composite(led_frame_t* out)
+{
+	const led_layer_t* active[LED_NUM_OVERLAYS];
+	uint8_t num_active = 0;
+	for (uint8_t z = 0; z < LED_NUM_ZONES; z++) {
+		led_zone_composite(&layers[z], out);
+	}
+	for (uint8_t l = LED_NUM_ZONES; l < LED_NUM_LAYERS; l++) {
+		if (layers[l].pattern && layers[l].opacity) {
+			active[num_active++] = &layers[l];
+		}
+	}
+	if (!num_active) {
+		return;
+	}
+	for (uint32_t i = 0; i < out->num; i++) {
+		int32_t r = out->pixels[i].r, g = out->pixels[i].g, b = out->pixels[i].b;
+		for (uint8_t l = 0; l < num_active; l++) {
+			led_blend(&r, &g, &b, &active[l]->frame.pixels[i], active[l]->opacity, active[l]->blend);
+		}
+		out->pixels[i] = (led_rgb_t) { r, g, b };
+	}
+}
+
+uint32_t led_layers_overruns()
+{
+	return overruns;
+}
@@ -0,0 +1,59 @@
+#ifndef LED_LAYERS_H
+#define LED_LAYERS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#include "led_frame.h"
+#include "led_patterns.h"
+
+/*
+ * The first layers are the zones, side by side along the strip, each with a
+ * pattern of its own. The overlays above them cover the whole strip.
+ */
+#if CONFIG_LED_ZONES
+#define LED_NUM_ZONES		CONFIG_LED_ZONES
+#else
+#define LED_NUM_ZONES		1
+#endif
+#define LED_NUM_OVERLAYS	3
+#define LED_NUM_LAYERS		(LED_NUM_ZONES + LED_NUM_OVERLAYS)
+/* Largest pattern state a layer can hold with CONFIG_LED_STATIC_ALLOC */
+#define LED_LAYER_STATE_MAX	1024
+
+/* How a layer is combined with the layers below it, scaled by its opacity */
+typedef enum {
+	LED_BLEND_ALPHA,
+	LED_BLEND_ADD,
+	LED_BLEND_SCREEN,
+	LED_BLEND_MULTIPLY,
+	LED_BLEND_MAX,
+	LED_BLEND_NUM
+} led_blend_t;
+
+/* Where a zone's pattern goes on the strip */
+typedef struct {
+	uint32_t offset;
+	uint32_t num;
+	bool reverse;		/* the pattern starts at the far end */
+	bool mirror;		/* the pattern covers half the zone and is reflected onto the rest */
+} led_span_t;
+
+typedef struct {
+	led_pattern_t* pattern;	/* NULL turns the layer off */
+	led_blend_t blend;
+	uint8_t opacity;
+	int64_t start;		/* us, the layer keeps its old pattern until then */
+} led_layer_params_t;
+
+bool led_zones_parse(const char* layout, uint32_t num, led_span_t* spans);
+void led_layers_init(uint32_t num);
+void led_zone_get_span(uint8_t zone, led_span_t* span);
+void led_layer_set(uint8_t layer, const led_layer_params_t* params);
+void led_layer_get(uint8_t layer, led_layer_params_t* params);
+bool led_layers_render(int64_t now, int64_t* next);
+void led_layers_shift(int64_t delta);
+void led_layers_composite(led_frame_t* out);
+uint32_t led_layers_overruns(void);
+
+#endif /* LED_LAYERS_H */
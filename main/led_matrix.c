@@ -0,0 +1,117 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fixed.h"
+#include "led_matrix.h"
+#include "noise.h"
+
+bool led_matrix_init(led_matrix_t* matrix, const led_matrix_config_t* config, uint16_t* map)
+{
+	uint32_t pw = config->panel_width;
+	uint32_t ph = config->panel_height;
+	uint32_t width = pw * config->panels_x;
+	uint32_t height = ph * config->panels_y;
+	if (!width || !height || width * height > UINT16_MAX) {
+		return false;
+	}
+	matrix->width = width;
+	matrix->height = height;
+	matrix->map = map;
+	/* Divides are fine here, this runs once */
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t px = x / pw, py = y / ph;
+			uint32_t lx = x % pw, ly = y % ph;
+			uint32_t local;
+			if (config->tiles_serpentine && (py & 1)) {
+				px = config->panels_x - 1 - px;
+			}
+			if (config->vertical) {
+				if (config->serpentine && (lx & 1)) {
+					ly = ph - 1 - ly;
+				}
+				local = lx * ph + ly;
+			} else {
+				if (config->serpentine && (ly & 1)) {
+					lx = pw - 1 - lx;
+				}
+				local = ly * pw + lx;
+			}
+			map[y * width + x] = (py * config->panels_x + px) * pw * ph + local;
+		}
+	}
+	return true;
+}
+
+/* Waves across, down and diagonally, each spanning the wall once, summed into a palette index */
+void led_matrix_plasma(led_frame2d_t* frame, const led_rgb_t* palette, uint32_t t)
+{
+	uint32_t kx = (256 << 8) / frame->width;	/* 8.8 phase per pixel */
+	uint32_t ky = (256 << 8) / frame->height;
+	uint8_t a = t >> 2, b = -(t >> 3), c = t >> 4;
+	led_rgb_t* p = frame->pixels;
+	for (uint32_t y = 0; y < frame->height; y++) {
+		uint32_t dy = y * ky;
+		uint16_t wy = sin8((dy >> 8) + b);
+		for (uint32_t x = 0; x < frame->width; x++) {
+			uint32_t dx = x * kx;
+			uint16_t v = sin8((dx >> 8) + a) + wy + sin8(((dx + dy) >> 9) + c);
+			*p++ = palette[(v * 85) >> 8];
+		}
+	}
+}
+
+/* Black through red and yellow to white, a third each */
+static led_rgb_t led_matrix_heat_color(uint8_t heat)
+{
+	uint8_t t192 = scale8_video(heat, 191);
+	uint8_t ramp = (t192 & 63) << 2;
+	if (t192 & 128) {
+		return (led_rgb_t) { 255, 255, ramp };
+	} else if (t192 & 64) {
+		return (led_rgb_t) { 255, ramp, 0 };
+	}
+	return (led_rgb_t) { ramp, 0, 0 };
+}
+
+/* Noise rising through the frame, cooling towards the top */
+void led_matrix_fire(led_frame2d_t* frame, uint32_t t)
+{
+	uint32_t kx = (4 << 16) / frame->width;	/* 8.8 noise units per pixel, 4 cells across */
+	uint32_t ky = (3 << 16) / frame->height;	/* and 3 down */
+	uint32_t cool_step = (255 << 8) / frame->height;
+	uint32_t rise = t >> 1;
+	led_rgb_t* p = frame->pixels;
+	for (uint32_t y = 0; y < frame->height; y++) {
+		uint8_t cool = ((frame->height - 1 - y) * cool_step) >> 8;
+		uint32_t ny = ((y * ky) >> 8) + rise;
+		for (uint32_t x = 0; x < frame->width; x++) {
+			uint8_t n = noise8_2d((x * kx) >> 8, ny);
+			*p++ = led_matrix_heat_color(qsub8(qadd8(n, n >> 1), cool));
+		}
+	}
+}
+
+void led_matrix_text(led_frame2d_t* frame, const uint8_t* font, const char* text,
+		     int32_t x, int32_t y, led_rgb_t color)
+{
+	/* Rows of the glyphs that are on the frame */
+	int32_t top = (y < 0) ? -y : 0;
+	int32_t bottom = (y + 8 > frame->height) ? frame->height - y : 8;
+	for (; *text && x < frame->width; text++, x += 8) {
+		if (x <= -8) {
+			continue;
+		}
+		const uint8_t* glyph = &font[(*text & 127) * 8];
+		for (int32_t col = 0; col < 8; col++) {
+			if (x + col < 0 || x + col >= frame->width) {
+				continue;
+			}
+			for (int32_t row = top; row < bottom; row++) {
+				if (glyph[col] & (1 << row)) {
+					*led_frame2d_xy(frame, x + col, y + row) = color;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef LED_MATRIX_H
+#define LED_MATRIX_H
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "led_frame.h"
+
+/*
+ * LED walls are built from panels of panel_width x panel_height pixels,
+ * tiled panels_x across and panels_y down and chained from the top left.
+ * Patterns draw row-major from the top left of the wall and a lookup table
+ * takes each pixel to its place on the wiring.
+ */
+typedef struct {
+	uint16_t panel_width;
+	uint16_t panel_height;
+	uint8_t panels_x;
+	uint8_t panels_y;
+	bool vertical;		/* panels are wired in columns rather than rows */
+	bool serpentine;	/* every other row (or column) of a panel runs backwards */
+	bool tiles_serpentine;	/* every other row of panels runs right to left */
+} led_matrix_config_t;
+
+typedef struct {
+	uint16_t width;
+	uint16_t height;
+	const uint16_t* map;	/* strip index of each pixel, row-major */
+} led_matrix_t;
+
+/* A frame seen as height rows of width pixels */
+typedef struct {
+	led_rgb_t* pixels;
+	uint16_t width;
+	uint16_t height;
+} led_frame2d_t;
+
+static inline led_rgb_t* led_frame2d_xy(const led_frame2d_t* frame, uint16_t x, uint16_t y)
+{
+	return &frame->pixels[y * frame->width + x];
+}
+
+/* Fills map, which holds the width x height entries of the wall, false if the layout is empty */
+bool led_matrix_init(led_matrix_t* matrix, const led_matrix_config_t* config, uint16_t* map);
+
+/*
+ * 2D effects. Plasma and fire draw the whole frame and move along with t,
+ * which patterns advance by 256 per period. Text only draws its own pixels,
+ * with a font of 8 bytes per glyph for the first 128 characters, one byte
+ * per column with the top pixel in bit 0, like font8x8_basic_tr.
+ */
+void led_matrix_plasma(led_frame2d_t* frame, const led_rgb_t* palette, uint32_t t);
+void led_matrix_fire(led_frame2d_t* frame, uint32_t t);
+void led_matrix_text(led_frame2d_t* frame, const uint8_t* font, const char* text,
+		     int32_t x, int32_t y, led_rgb_t color);
+
+#endif /* LED_MATRIX_H */
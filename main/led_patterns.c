@@ -2,141 +2,288 @@
 #include <stdint.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include "esp_log.h"
+#if CONFIG_LED_MATRIX
+#include "font8x8_basic.h"
+#endif
 
 #include "leds.h"
+#include "led_layers.h"
 #include "led_patterns.h"
+#include "led_show.h"
+#include "noise.h"
+#include "palette.h"
+#include "particles.h"
+#include "rng.h"
 
 #define TAG "LED_pat"
 
-void pat_rainbow(led_strip_t* strip)
+#define LED_FRAME_MS	20
+#define LED_FRAME_US	(LED_FRAME_MS * 1000)
+/* Per layer, as many as fit in LED_LAYER_STATE_MAX */
+#define PAT_PARTICLES	48
+
+typedef struct {
+	uint32_t pos;
+} pat_pos_t;
+
+typedef struct {
+	uint32_t pos;
+	bool reverse;
+} pat_bounce_t;
+
+/* Scrolling patterns keep their last frame and only draw the pixel that comes in */
+typedef struct {
+	uint32_t pos;
+	uint32_t hue;
+	uint8_t intensity;
+	bool drawn;
+} pat_scroll_t;
+
+/*
+ * Moves the frame along by one and returns the first pixel to draw. The whole
+ * frame is drawn again at the start, when the colour changes and when pos wraps.
+ */
+static uint32_t pat_scroll(led_frame_t* frame, pat_scroll_t* s, uint32_t hue, uint8_t intensity)
 {
-	int step = 360 / led_get_num();
-	int pos = 0;
-	while (!led_should_stop()) {
-		for (int i = 0; i < led_get_num(); i++) {
-			uint32_t hue = ((i + pos) * step) % 360;
-			uint8_t r, g, b;
-			led_strip_hsv2rgb(hue, 100, led_get_intensity(), &r, &g, &b);
-			ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
-		}
-		ESP_ERROR_CHECK(strip->refresh(strip, 0));
-		pos = (pos + 1) % led_get_num();
-		vTaskDelay(pdMS_TO_TICKS(led_get_period()));
+	if (s->drawn && s->pos && hue == s->hue && intensity == s->intensity) {
+		led_frame_rotate(frame, -1);
+		return frame->num - 1;
 	}
+	s->drawn = true;
+	s->hue = hue;
+	s->intensity = intensity;
+	return 0;
 }
 
-void pat_bounce(led_strip_t* strip)
+uint32_t pat_rainbow(led_frame_t* frame, void* state)
 {
-	int pos = 0, i = 0;
-	bool reverse = 0;
-	while (!led_should_stop()) {
-		uint8_t r, g, b;
-		if (reverse) {
-			i = led_get_num() - pos - 1;
-		} else {
-			i = pos;
+	pat_scroll_t* s = state;
+	uint8_t intensity = led_get_render_intensity();
+	int step = 360 / frame->num;
+	uint32_t first = pat_scroll(frame, s, 0, intensity);
+	uint32_t hue = ((s->pos + first) * step) % 360;
+	for (int i = first; i < frame->num; i++) {
+		led_rgb_t* p = &frame->pixels[i];
+		led_strip_hsv2rgb(hue, 100, intensity, &p->r, &p->g, &p->b);
+		hue += step;
+		if (hue >= 360) {
+			hue -= 360;
 		}
-		led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_intensity(), &r, &g, &b);
-		ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
-		ESP_ERROR_CHECK(strip->refresh(strip, 0));
-		ESP_ERROR_CHECK(strip->set_pixel(strip, i, 0, 0, 0));
-		if (pos == (led_get_num() - 1)) {
-			reverse = !reverse;
-		}
-		pos = (pos + 1) % led_get_num();
-		vTaskDelay(pdMS_TO_TICKS(led_get_period()));
 	}
+	s->pos = (s->pos + 1) % frame->num;
+	return led_get_period_us();
 }
 
-void pat_marquee(led_strip_t* strip)
+uint32_t pat_marquee(led_frame_t* frame, void* state)
 {
-	int pos = 0;
-	while (!led_should_stop()) {
-		for (int i = 0; i < led_get_num(); i++) {
-			uint8_t r, g, b;
-			if ((i + pos) % 4 == 0) {
-				led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_intensity(), &r, &g, &b);
-			} else {
-				r = g = b = 0;
-			}
-			ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
+	pat_scroll_t* s = state;
+	uint32_t hue = led_get_primary_hue();
+	uint8_t intensity = led_get_render_intensity();
+	uint32_t first = pat_scroll(frame, s, hue, intensity);
+	led_rgb_t on;
+	led_strip_hsv2rgb(hue, 100, intensity, &on.r, &on.g, &on.b);
+	for (int i = first; i < frame->num; i++) {
+		if (((i + s->pos) & 3) == 0) {
+			frame->pixels[i] = on;
+		} else {
+			frame->pixels[i] = (led_rgb_t) { 0, 0, 0 };
 		}
-		ESP_ERROR_CHECK(strip->refresh(strip, 0));
-		pos = (pos + 1) % led_get_num();
-		vTaskDelay(pdMS_TO_TICKS(led_get_period()));
 	}
+	s->pos = (s->pos + 1) % frame->num;
+	return led_get_period_us();
 }
 
-void pat_rainbowcyl(led_strip_t* strip)
+uint32_t pat_rainbowcyl(led_frame_t* frame, void* state)
 {
-	int pos = 0, i = 0;
-	bool reverse = false;
-	int step = 360 / led_get_num();
-	while (!led_should_stop()) {
-		uint8_t r, g, b;
-		int hue = (pos * step) % 360;
-		if (reverse) {
-			i = led_get_num() - pos - 1;
-		} else {
-			i = pos;
-		}
-		led_strip_hsv2rgb(hue, 100, led_get_intensity(), &r, &g, &b);
-		ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
-		ESP_ERROR_CHECK(strip->refresh(strip, 0));
-		ESP_ERROR_CHECK(strip->set_pixel(strip, i, 0, 0, 0));
-		if (pos == (led_get_num() - 1)) {
-			reverse = !reverse;
-		}
-		pos = (pos + 1) % led_get_num();
-		vTaskDelay(pdMS_TO_TICKS(led_get_period()));
+	pat_bounce_t* s = state;
+	int step = 360 / frame->num;
+	int hue = (s->pos * step) % 360;
+	uint32_t i = s->reverse ? frame->num - s->pos - 1 : s->pos;
+	led_rgb_t* p = &frame->pixels[i];
+	led_frame_clear(frame);
+	led_strip_hsv2rgb(hue, 100, led_get_render_intensity(), &p->r, &p->g, &p->b);
+	if (s->pos == (frame->num - 1)) {
+		s->reverse = !s->reverse;
 	}
+	s->pos = (s->pos + 1) % frame->num;
+	return led_get_period_us();
 }
 
-void pat_solid(led_strip_t* strip)
+uint32_t pat_solid(led_frame_t* frame, void* state)
 {
-	for (int i = 0; i < led_get_num(); i++) {
-		uint8_t r, g, b;
-		led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_intensity(), &r, &g, &b);
-		ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
+	led_rgb_t c;
+	led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_render_intensity(), &c.r, &c.g, &c.b);
+	led_frame_fill(frame, c);
+	return led_get_period_us();
+}
+
+typedef struct {
+	rng_t rng;
+	particles_t pool;
+	int32_t wait;
+	uint32_t storage[(PARTICLES_STORAGE_SIZE(PAT_PARTICLES) + 3) / sizeof(uint32_t)];
+} pat_particles_t;
+
+_Static_assert(sizeof(pat_particles_t) <= LED_LAYER_STATE_MAX, "pat_particles_t doesn't fit in LED_LAYER_STATE_MAX");
+
+static void _pat_particles_init(void* state, particles_edge_t edge, uint8_t drag)
+{
+	pat_particles_t* s = state;
+	rng_seed(&s->rng, 0);
+	particles_init(&s->pool, s->storage, PAT_PARTICLES);
+	s->pool.edge = edge;
+	s->pool.drag = drag;
+}
+
+/* One pixel per period, in pixels per frame */
+static int32_t pat_particles_speed(void)
+{
+	return PARTICLES_FIXED(LED_FRAME_US) / (int32_t)led_get_period_us();
+}
+
+/* True about once every so many periods */
+static bool pat_particles_chance(pat_particles_t* s, uint32_t periods)
+{
+	return !rng_below(&s->rng, periods * led_get_period_us() / LED_FRAME_US + 1);
+}
+
+static uint32_t pat_particles_frame(led_frame_t* frame, pat_particles_t* s)
+{
+	led_frame_clear(frame);
+	particles_step(&s->pool, frame->num);
+	particles_render(&s->pool, frame);
+	return LED_FRAME_US;
+}
+
+void pat_cylon_init(led_frame_t* frame, void* state)
+{
+	pat_particles_t* s = state;
+	_pat_particles_init(state, PARTICLES_EDGE_BOUNCE, 0);
+	particles_emitter_t e = { .bright = 255 };
+	particles_emit(&s->pool, &e, &s->rng);
+}
+
+/* One particle bouncing between the ends, a pixel per period */
+uint32_t pat_cylon(led_frame_t* frame, void* state)
+{
+	pat_particles_t* s = state;
+	int32_t speed = pat_particles_speed();
+	s->pool.vel[0] = (s->pool.vel[0] < 0) ? -speed : speed;
+	led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_render_intensity(),
+			  &s->pool.color[0].r, &s->pool.color[0].g, &s->pool.color[0].b);
+	return pat_particles_frame(frame, s);
+}
+
+void pat_pulse_init(led_frame_t* frame, void* state)
+{
+	pat_particles_t* s = state;
+	_pat_particles_init(state, PARTICLES_EDGE_DIE, 0);
+	s->wait = PARTICLES_FIXED(frame->num);
+}
+
+/* A pulse with a tail runs along the strip four pixels per period, then the strip stays dark as long */
+uint32_t pat_pulse(led_frame_t* frame, void* state)
+{
+	pat_particles_t* s = state;
+	int32_t speed = 4 * pat_particles_speed();
+	led_rgb_t c;
+	led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_render_intensity(), &c.r, &c.g, &c.b);
+	if (!s->pool.num) {
+		s->wait += speed;
+		if (s->wait >= PARTICLES_FIXED(frame->num)) {
+			particles_emitter_t e = { .vel = speed, .bright = 255, .tail = 8 };
+			s->wait = 0;
+			particles_emit(&s->pool, &e, &s->rng);
+		}
 	}
-	ESP_ERROR_CHECK(strip->refresh(strip, 0));
-	while (!led_should_stop()) {
-		vTaskDelay(pdMS_TO_TICKS(led_get_period()));
+	for (uint32_t i = 0; i < s->pool.num; i++) {
+		s->pool.color[i] = c;
 	}
+	return pat_particles_frame(frame, s);
 }
 
-void pat_pulse(led_strip_t* strip)
+void pat_sparks_init(led_frame_t* frame, void* state)
 {
-	int pos = 0;
-	bool pulsing = 0;
-	while (!led_should_stop()) {
-		int i = 0;
-		uint8_t r, g, b;
-		uint32_t intensity;
-		if (pos == 0) {
-			pulsing = !pulsing;
-		}
-		if (pulsing) {
-			for (i = (pos - 8); i < pos; i++) {
-				if (i >= 0) {
-					intensity = led_get_intensity() / (1 << (9 - (pos - i)));
-					led_strip_hsv2rgb(led_get_primary_hue(), 100, intensity , &r, &g, &b);
-					ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
-				}
-			}
-		} else if (pos < 8) {
-			for (i = 1; i < 9 - pos; i++) {
-				intensity = led_get_intensity() / (1 << (9 - (pos + i)));
-				led_strip_hsv2rgb(led_get_primary_hue(), 100, intensity, &r, &g, &b);
-				ESP_ERROR_CHECK(strip->set_pixel(strip, (led_get_num() - i), r, g, b));
+	_pat_particles_init(state, PARTICLES_EDGE_DIE, 16);
+}
+
+/* Bursts of sparks at random places, about one every four periods, slowing down as they fade */
+uint32_t pat_sparks(led_frame_t* frame, void* state)
+{
+	pat_particles_t* s = state;
+	if (pat_particles_chance(s, 4)) {
+		const palette_t* pal = led_get_palette();
+		/* Each burst takes a stretch of the palette */
+		uint8_t index = rng_next(&s->rng);
+		particles_emitter_t e = {
+			.pos = PARTICLES_FIXED(rng_below(&s->rng, frame->num)),
+			.spread = 16 * pat_particles_speed(),
+			.bright = 255,
+			.fade = rng_range(&s->rng, 6, 12),
+			.tail = 1,
+		};
+		for (uint32_t n = rng_range(&s->rng, 6, 12); n; n--) {
+			e.color = *palette_get(pal, index + rng_below(&s->rng, 32));
+			if (particles_emit(&s->pool, &e, &s->rng) < 0) {
+				break;
 			}
 		}
-		ESP_ERROR_CHECK(strip->refresh(strip, 0));
-		pos = (pos + 1) % led_get_num();
-		vTaskDelay(pdMS_TO_TICKS(led_get_period() / 4));
 	}
+	return pat_particles_frame(frame, s);
+}
+
+void pat_comets_init(led_frame_t* frame, void* state)
+{
+	_pat_particles_init(state, PARTICLES_EDGE_DIE, 0);
+}
+
+/* Comets with long tails cross from either end at 4 to 16 pixels per period, about one every two periods */
+uint32_t pat_comets(led_frame_t* frame, void* state)
+{
+	pat_particles_t* s = state;
+	if (pat_particles_chance(s, 2)) {
+		int32_t speed = pat_particles_speed();
+		bool back = rng_next(&s->rng) & 1;
+		particles_emitter_t e = {
+			.pos = back ? PARTICLES_FIXED(frame->num - 1) : 0,
+			.vel = rng_range(&s->rng, 4 * speed, 16 * speed),
+			.bright = rng_range(&s->rng, 128, 255),
+			.tail = rng_range(&s->rng, 4, 16),
+			.color = *palette_get(led_get_palette(), rng_next(&s->rng)),
+		};
+		e.vel = back ? -e.vel : e.vel;
+		particles_emit(&s->pool, &e, &s->rng);
+	}
+	return pat_particles_frame(frame, s);
+}
+
+void pat_bubbles_init(led_frame_t* frame, void* state)
+{
+	/* With the buoyancy below they settle at about twice the speed they start at */
+	_pat_particles_init(state, PARTICLES_EDGE_DIE, 4);
+}
+
+/* Bubbles rise from the start of the strip at a pixel or so per period, one every four periods, and pop on the way */
+uint32_t pat_bubbles(led_frame_t* frame, void* state)
+{
+	pat_particles_t* s = state;
+	int32_t speed = pat_particles_speed();
+	s->pool.gravity = speed / 32;
+	if (pat_particles_chance(s, 4)) {
+		/* Frames to rise between a quarter and all of the strip */
+		uint32_t life = rng_range(&s->rng, frame->num / 4, frame->num) * (PARTICLES_FIXED(1) / (speed ? speed : 1));
+		particles_emitter_t e = {
+			.vel = speed,
+			.spread = speed / 2,
+			.life = (life > UINT16_MAX) ? UINT16_MAX : life,
+			.bright = rng_range(&s->rng, 64, 255),
+			.tail = 1,
+			.color = *palette_get(led_get_palette(), rng_next(&s->rng)),
+		};
+		particles_emit(&s->pool, &e, &s->rng);
+	}
+	return pat_particles_frame(frame, s);
 }
 
 /*
@@ -178,153 +325,254 @@ void pat_pulse(led_strip_t* strip)
 			sleep(self.period)
 */
 
-void pat_rgb_party(led_strip_t* strip)
+typedef struct {
+	uint32_t i;
+	uint8_t cycle;
+} pat_rgb_party_t;
+
+/* Wipe one pixel per tick, then hold for the rest of a third of a period */
+uint32_t pat_rgb_party(led_frame_t* frame, void* state)
 {
-	uint8_t cycle = 0;
-	while (!led_should_stop()) {
-		for (int i = 0; i < led_get_num(); i++) {
-			ESP_ERROR_CHECK(strip->set_pixel(strip, i, (cycle == 0 ? led_get_intensity() : 0),
-								   (cycle == 1 ? led_get_intensity() : 0),
-								   (cycle == 2 ? led_get_intensity() : 0)));
-			ESP_ERROR_CHECK(strip->refresh(strip, 0));
-			vTaskDelay(1);
-		}
-		cycle = (cycle + 1) % 3;
-		vTaskDelay(pdMS_TO_TICKS((led_get_period() / 3) - (led_get_period() / led_get_num())));
+	pat_rgb_party_t* s = state;
+	frame->pixels[s->i] = (led_rgb_t) {
+		(s->cycle == 0 ? led_get_render_intensity() : 0),
+		(s->cycle == 1 ? led_get_render_intensity() : 0),
+		(s->cycle == 2 ? led_get_render_intensity() : 0),
+	};
+	if (++s->i < frame->num) {
+		return portTICK_PERIOD_MS * 1000;
 	}
+	s->i = 0;
+	s->cycle = (s->cycle + 1) % 3;
+	return (led_get_period_us() / 3) - (led_get_period_us() / frame->num);
 }
 
-uint32_t esp_random_range(uint32_t min, uint32_t max)
+typedef struct {
+	uint32_t hmin, hmax;
+	uint32_t t;
+	uint8_t intensity;
+	palette_t heat;
+} pat_flame_t;
+
+static void _pat_flame_init(void* state, uint32_t hmin, uint32_t hmax)
 {
-	return (esp_random() % (max - min + 1)) + min;
+	pat_flame_t* s = state;
+	rng_t rng;
+	rng_seed(&rng, 0);
+	s->t = rng_next(&rng);
+	s->hmin = hmin;
+	s->hmax = hmax;
 }
 
-// adapted from an arduino pattern at:
-// http://www.funkboxing.com/wordpress/wp-content/_postfiles/fluxbox_octo.ino
-void _pat_flame_internal(led_strip_t* strip, uint32_t hmin, uint32_t hmax)
+/* Fire from 2D noise over position and time, hotter spots are brighter and closer to hmax */
+uint32_t pat_flame(led_frame_t* frame, void* state)
 {
-	uint8_t r, g, b;
-	int hdif = hmax - hmin;
-	uint32_t ahue = hmin;
-	ESP_ERROR_CHECK(strip->clear(strip, 0));
-	while (!led_should_stop()){
-		uint32_t idelay = esp_random_range(20, 200);
-		uint32_t randtemp = esp_random_range(3, 6);
-		uint32_t hinc = (hdif / led_get_num()) + randtemp;
-		uint32_t spread = esp_random_range(5, led_get_num() / 3);
-		uint32_t start = esp_random_range(0, led_get_num() - spread);
-		for (int i = start; i < (start + spread); i++) {
-			if ((ahue + hinc) > hmax) {
-				ahue = hmin;
-			} else {
-				ahue = ahue + hinc;
-			}
-			led_strip_hsv2rgb(ahue, 100, led_get_intensity(), &r, &g, &b);
-			ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
-			ESP_ERROR_CHECK(strip->refresh(strip, 0));
-			vTaskDelay(pdMS_TO_TICKS(idelay));
-		}
-		vTaskDelay(pdMS_TO_TICKS(esp_random_range(0, 4) * led_get_period()));
+	pat_flame_t* s = state;
+	if (s->intensity != led_get_render_intensity()) {
+		s->intensity = led_get_render_intensity();
+		palette_fill_hsv(&s->heat, 0, 255, s->hmin, s->hmax, s->intensity / 4, s->intensity);
 	}
+	for (int i = 0; i < frame->num; i++) {
+		frame->pixels[i] = *palette_get(&s->heat, noise8_octaves_2d(i << 5, s->t, 3));
+	}
+	/* One noise cell per period */
+	s->t += (LED_FRAME_MS << 8) / led_get_period();
+	return LED_FRAME_US;
+}
+
+void pat_flame_init(led_frame_t* frame, void* state)
+{
+	_pat_flame_init(state, 0, 40);
+}
+
+void pat_flame_g_init(led_frame_t* frame, void* state)
+{
+	_pat_flame_init(state, 80, 160);
+}
+
+void pat_flame_b_init(led_frame_t* frame, void* state)
+{
+	_pat_flame_init(state, 170, 290);
+}
+
+void pat_flame_rbow_init(led_frame_t* frame, void* state)
+{
+	_pat_flame_init(state, 0, 360);
 }
 
-void pat_flame(led_strip_t* strip)
+typedef struct {
+	uint32_t t;
+} pat_plasma_t;
+
+void pat_plasma_init(led_frame_t* frame, void* state)
 {
-	_pat_flame_internal(strip, 0, 40);
+	pat_plasma_t* s = state;
+	rng_t rng;
+	rng_seed(&rng, 0);
+	s->t = rng_next(&rng);
 }
 
-void pat_flame_g(led_strip_t* strip)
+/* Two layers of noise picking colours from the palette, and a third for brightness */
+uint32_t pat_plasma(led_frame_t* frame, void* state)
 {
-	_pat_flame_internal(strip, 80, 160);
+	pat_plasma_t* s = state;
+	const palette_t* pal = led_get_palette();
+	for (int i = 0; i < frame->num; i++) {
+		uint8_t n = (noise8_2d(i << 4, s->t) + noise8_2d(i << 6, s->t << 1)) >> 1;
+		uint8_t v = 128 + (noise8_3d(i << 5, s->t, s->t >> 1) >> 1);
+		frame->pixels[i] = led_rgb_scale(*palette_get(pal, n), v);
+	}
+	s->t += (LED_FRAME_MS << 8) / led_get_period();
+	return LED_FRAME_US;
 }
 
-void pat_flame_b(led_strip_t* strip)
+/* The whole palette stretched over the strip, scrolling 16 entries per period */
+uint32_t pat_palette(led_frame_t* frame, void* state)
 {
-	_pat_flame_internal(strip, 170, 290);
+	pat_pos_t* s = state;	/* pos is an 8.8 fixed point palette index */
+	const palette_t* pal = led_get_palette();
+	uint32_t step = (256 << 8) / frame->num;
+	for (int i = 0; i < frame->num; i++) {
+		frame->pixels[i] = *palette_get(pal, (i * step + s->pos) >> 8);
+	}
+	s->pos += (LED_FRAME_MS << 12) / led_get_period();
+	return LED_FRAME_US;
 }
 
-void pat_flame_rbow(led_strip_t* strip)
+typedef struct {
+	rng_t rng;
+	uint32_t i;
+	uint32_t max_flickers;
+	uint32_t num_flickers;
+	uint32_t delay;
+	uint32_t prob;
+	bool flash;
+	led_rgb_t c1, c2;
+} pat_flicker_t;
+
+void pat_flicker_init(led_frame_t* frame, void* state)
 {
-	_pat_flame_internal(strip, 0, 360);
+	pat_flicker_t* s = state;
+	rng_seed(&s->rng, 0);
+	s->max_flickers = (frame->num / 16 ? frame->num / 16 : 1);
+	s->num_flickers = rng_range(&s->rng, 1, s->max_flickers);
 }
 
-void pat_flicker(led_strip_t* strip)
+/* Scans the strip in the secondary hue, stopping to flash the primary hue now and then */
+uint32_t pat_flicker(led_frame_t* frame, void* state)
 {
-	uint8_t r, g, b;
-	uint32_t num_flickers = esp_random_range(1, (led_get_num() / 16 ? led_get_num() / 16 : 1));
-	while (!led_should_stop()) {
-		uint32_t delay = esp_random_range(40, 160);
-		uint32_t prob = esp_random_range(20, 40);
-		for (int i = 0; i < led_get_num(); i++) {
-			if (!esp_random_range(0, prob)) {
-				led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_intensity(), &r, &g, &b);
-				ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
-				if (!num_flickers) {
-					ESP_ERROR_CHECK(strip->refresh(strip, 0));
-					vTaskDelay(pdMS_TO_TICKS(delay));
-					num_flickers = esp_random_range(1, (led_get_num() / 16 ? led_get_num() / 16 : 1));
-				} else {
-					num_flickers--;
-					continue;
-				}
+	pat_flicker_t* s = state;
+	if (s->flash) {
+		frame->pixels[s->i - 1] = s->c2;
+		s->flash = false;
+	} else if (!s->i) {
+		s->delay = rng_range(&s->rng, 40, 160);
+		s->prob = rng_range(&s->rng, 20, 40);
+		led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_render_intensity(), &s->c1.r, &s->c1.g, &s->c1.b);
+		led_strip_hsv2rgb(led_get_secondary_hue(), 100, led_get_render_intensity(), &s->c2.r, &s->c2.g, &s->c2.b);
+	}
+	while (s->i < frame->num) {
+		led_rgb_t* p = &frame->pixels[s->i++];
+		if (!rng_below(&s->rng, s->prob + 1)) {
+			*p = s->c1;
+			if (!s->num_flickers) {
+				s->num_flickers = rng_range(&s->rng, 1, s->max_flickers);
+				s->flash = true;
+				return s->delay * 1000;
 			}
-			led_strip_hsv2rgb(led_get_secondary_hue(), 100, led_get_intensity(), &r, &g, &b);
-			ESP_ERROR_CHECK(strip->set_pixel(strip, i, r, g, b));
+			s->num_flickers--;
+			continue;
 		}
-		ESP_ERROR_CHECK(strip->refresh(strip, 0));
-		vTaskDelay(pdMS_TO_TICKS(led_get_period() / esp_random_range(2, 8)));
+		*p = s->c2;
 	}
+	s->i = 0;
+	return led_get_period_us() / rng_range(&s->rng, 2, 8);
 }
 
+#if CONFIG_LED_MATRIX
+typedef struct {
+	uint32_t t;
+} pat_2d_t;
+
+typedef struct {
+	int32_t x;
+} pat_text_t;
+
+/* The layer's frame as the rows of the wall, or as one row before the wall is set up */
+static led_frame2d_t pat_frame2d(led_frame_t* frame)
+{
+	const led_matrix_t* matrix = led_get_matrix();
+	uint16_t width = matrix->width ? matrix->width : frame->num;
+	return (led_frame2d_t) { frame->pixels, width, frame->num / width };
+}
+
+uint32_t pat_plasma2d(led_frame_t* frame, void* state)
+{
+	pat_2d_t* s = state;
+	led_frame2d_t f = pat_frame2d(frame);
+	led_matrix_plasma(&f, palette_get(led_get_palette(), 0), s->t);
+	s->t += (LED_FRAME_MS << 8) / led_get_period();
+	return LED_FRAME_US;
+}
+
+uint32_t pat_fire2d(led_frame_t* frame, void* state)
+{
+	pat_2d_t* s = state;
+	led_frame2d_t f = pat_frame2d(frame);
+	led_matrix_fire(&f, s->t);
+	s->t += (LED_FRAME_MS << 8) / led_get_period();
+	return LED_FRAME_US;
+}
+
+void pat_text_init(led_frame_t* frame, void* state)
+{
+	pat_text_t* s = state;
+	s->x = pat_frame2d(frame).width;
+}
+
+/* Scrolls in from the right in the primary hue, eight columns per period */
+uint32_t pat_text(led_frame_t* frame, void* state)
+{
+	pat_text_t* s = state;
+	led_frame2d_t f = pat_frame2d(frame);
+	const char* text = CONFIG_LED_MATRIX_TEXT;
+	led_rgb_t c;
+	led_strip_hsv2rgb(led_get_primary_hue(), 100, led_get_render_intensity(), &c.r, &c.g, &c.b);
+	led_frame_clear(frame);
+	led_matrix_text(&f, &font8x8_basic_tr[0][0], text, s->x, (f.height - 8) / 2, c);
+	if (--s->x < -(int32_t)(strlen(text) * 8)) {
+		s->x = f.width;
+	}
+	return led_get_period_us() / 8;
+}
+#endif
+
+#define PATTERN(n, r, st, i) { .name = n, .render = r, .state_size = sizeof(st), .init = i }
+
 led_pattern_t patterns[LED_NUM_PATTERNS] = {
-	(led_pattern_t) {
-		.name = "Rainbow",
-		.start = pat_rainbow,
-	},
-	(led_pattern_t) {
-		.name = "Cylon",
-		.start = pat_bounce,
-	},
-	(led_pattern_t) {
-		.name = "RCylon",
-		.start = pat_rainbowcyl,
-	},
-	(led_pattern_t) {
-		.name = "Marquee",
-		.start = pat_marquee,
-	},
-	(led_pattern_t) {
-		.name = "Pulse",
-		.start = pat_pulse,
-	},
-	(led_pattern_t) {
-		.name = "RGB Party",
-		.start = pat_rgb_party,
-	},
-	(led_pattern_t) {
-		.name = "R flame",
-		.start = pat_flame,
-	},
-	(led_pattern_t) {
-		.name = "G flame",
-		.start = pat_flame_g,
-	},
-	(led_pattern_t) {
-		.name = "B flame",
-		.start = pat_flame_b,
-	},
-	(led_pattern_t) {
-		.name = "RB flame",
-		.start = pat_flame_rbow,
-	},
-	(led_pattern_t) {
-		.name = "Solid",
-		.start = pat_solid,
-	},
-	(led_pattern_t) {
-		.name = "Flicker",
-		.start = pat_flicker,
-	},
+	PATTERN("Rainbow", pat_rainbow, pat_scroll_t, NULL),
+	PATTERN("Cylon", pat_cylon, pat_particles_t, pat_cylon_init),
+	PATTERN("RCylon", pat_rainbowcyl, pat_bounce_t, NULL),
+	PATTERN("Marquee", pat_marquee, pat_scroll_t, NULL),
+	PATTERN("Pulse", pat_pulse, pat_particles_t, pat_pulse_init),
+	PATTERN("RGB Party", pat_rgb_party, pat_rgb_party_t, NULL),
+	PATTERN("R flame", pat_flame, pat_flame_t, pat_flame_init),
+	PATTERN("G flame", pat_flame, pat_flame_t, pat_flame_g_init),
+	PATTERN("B flame", pat_flame, pat_flame_t, pat_flame_b_init),
+	PATTERN("RB flame", pat_flame, pat_flame_t, pat_flame_rbow_init),
+	PATTERN("Plasma", pat_plasma, pat_plasma_t, pat_plasma_init),
+	PATTERN("Palette", pat_palette, pat_pos_t, NULL),
+	{ .name = "Solid", .render = pat_solid },
+	PATTERN("Flicker", pat_flicker, pat_flicker_t, pat_flicker_init),
+	PATTERN("Show", pat_show, led_show_state_t, pat_show_init),
+	PATTERN("Sparks", pat_sparks, pat_particles_t, pat_sparks_init),
+	PATTERN("Comets", pat_comets, pat_particles_t, pat_comets_init),
+	PATTERN("Bubbles", pat_bubbles, pat_particles_t, pat_bubbles_init),
+#if CONFIG_LED_MATRIX
+	PATTERN("Plasma 2D", pat_plasma2d, pat_2d_t, NULL),
+	PATTERN("Fire 2D", pat_fire2d, pat_2d_t, NULL),
+	PATTERN("Text", pat_text, pat_text_t, pat_text_init),
+#endif
 };
 
 ui_menu_t led_pattern_menu[LED_NUM_PATTERNS];
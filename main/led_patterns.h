@@ -1,17 +1,30 @@
 #ifndef LED_PATTERNS_H
 #define LED_PATTERNS_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "freertos/FreeRTOS.h"
-#include "led_strip.h"
+#include "led_frame.h"
 #include "ui.h"
 
+#define LED_PATTERN_NAME_LEN	17
+
 typedef struct {
 	/* this must be first! */
-	char name[17];
-	void (*start)(led_strip_t*);
+	char name[LED_PATTERN_NAME_LEN];
+	/* bytes of zeroed state handed to init and render, per instance */
+	size_t state_size;
+	/* optional, called once when the pattern starts on a layer */
+	void (*init)(led_frame_t* frame, void* state);
+	/* render the next frame, returns microseconds until the following one */
+	uint32_t (*render)(led_frame_t* frame, void* state);
 } led_pattern_t;
 
-#define LED_NUM_PATTERNS	12
+#if CONFIG_LED_MATRIX
+#define LED_NUM_PATTERNS	21
+#else
+#define LED_NUM_PATTERNS	18
+#endif
 
 led_pattern_t* get_patterns(void);
 ui_menu_t* get_pattern_menu(void);
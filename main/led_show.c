@@ -0,0 +1,154 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+
+#include "leds.h"
+#include "led_show.h"
+
+#define TAG "LED_show"
+
+#define LED_SHOW_PAD(len)	(((len) + 3) & ~3)
+
+static const led_show_header_t* show = NULL;
+
+/* Walk the whole stream once so playback never has to bounds check the flash mapping */
+static bool led_show_validate(const led_show_header_t* hdr, uint32_t size)
+{
+	if (hdr->magic != LED_SHOW_MAGIC || hdr->version != LED_SHOW_VERSION) {
+		ESP_LOGE(TAG, "Bad show header %08x v%u", hdr->magic, hdr->version);
+		return false;
+	}
+	if (!hdr->num_frames || !hdr->period) {
+		ESP_LOGE(TAG, "Empty show");
+		return false;
+	}
+	if (hdr->bytes_per_led != sizeof(led_rgb_t)) {
+		ESP_LOGE(TAG, "Show has %u bytes per LED", hdr->bytes_per_led);
+		return false;
+	}
+	uint32_t frame_size = hdr->num_leds * hdr->bytes_per_led;
+	uint32_t offset = sizeof(led_show_header_t);
+	for (uint32_t i = 0; i < hdr->num_frames; i++) {
+		if (offset + sizeof(led_show_frame_t) > size) {
+			ESP_LOGE(TAG, "Frame %u header past end of partition", i);
+			return false;
+		}
+		const led_show_frame_t* frame = (const led_show_frame_t*)((const uint8_t*)hdr + offset);
+		offset += sizeof(led_show_frame_t);
+		if (frame->length > size - offset) {
+			ESP_LOGE(TAG, "Frame %u payload past end of partition", i);
+			return false;
+		}
+		if (frame->type == LED_SHOW_KEYFRAME) {
+			if (frame->length != frame_size) {
+				ESP_LOGE(TAG, "Keyframe %u is %u bytes, expected %u", i, frame->length, frame_size);
+				return false;
+			}
+		} else if (frame->type != LED_SHOW_DELTA || i == 0) {
+			ESP_LOGE(TAG, "Frame %u has bad type %u", i, frame->type);
+			return false;
+		}
+		offset += LED_SHOW_PAD(frame->length);
+	}
+	return true;
+}
+
+static const led_show_header_t* led_show_map(void)
+{
+	if (show) {
+		return show;
+	}
+	const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+			ESP_PARTITION_SUBTYPE_ANY, LED_SHOW_PARTITION);
+	if (!part) {
+		ESP_LOGE(TAG, "No %s partition", LED_SHOW_PARTITION);
+		return NULL;
+	}
+	const void* ptr;
+	spi_flash_mmap_handle_t handle;
+	if (esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &ptr, &handle) != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to map %s partition", LED_SHOW_PARTITION);
+		return NULL;
+	}
+	if (!led_show_validate(ptr, part->size)) {
+		spi_flash_munmap(handle);
+		return NULL;
+	}
+	/* Stays mapped for good, shows are replayed over and over */
+	show = ptr;
+	ESP_LOGI(TAG, "Show: %u frames of %u LEDs at %ums", show->num_frames, show->num_leds, show->period);
+	return show;
+}
+
+static void led_show_apply_delta(uint8_t* buf, uint32_t len, const uint8_t* delta, uint32_t delta_len)
+{
+	const uint8_t* end = delta + delta_len;
+	uint32_t pos = 0;
+	while (delta < end && pos < len) {
+		uint8_t ctrl = *delta++;
+		uint32_t run = (ctrl & 0x7f) + 1;
+		if (run > len - pos) {
+			run = len - pos;
+		}
+		if (ctrl & 0x80) {
+			if (run > end - delta) {
+				run = end - delta;
+			}
+			for (uint32_t i = 0; i < run; i++) {
+				buf[pos + i] ^= delta[i];
+			}
+			delta += run;
+		}
+		pos += run;
+	}
+}
+
+void pat_show_init(led_frame_t* frame, void* state)
+{
+	const led_show_header_t* hdr = led_show_map();
+	if (hdr && hdr->num_leds != frame->num) {
+		ESP_LOGE(TAG, "Show is for %u LEDs, strip has %u", hdr->num_leds, frame->num);
+	}
+}
+
+uint32_t pat_show(led_frame_t* frame, void* state)
+{
+	led_show_state_t* s = state;
+	if (!show || show->num_leds != frame->num) {
+		led_frame_clear(frame);
+		return led_get_period_us();
+	}
+	if (!s->pos || s->frame >= show->num_frames) {
+		s->pos = (const uint8_t*)(show + 1);
+		s->frame = 0;
+	}
+	const led_show_frame_t* hdr = (const led_show_frame_t*)s->pos;
+	const uint8_t* payload = (const uint8_t*)(hdr + 1);
+	uint32_t len = frame->num * sizeof(led_rgb_t);
+	/* Decode straight from flash into the layer, compositing copies it to the strip */
+	if (hdr->type == LED_SHOW_KEYFRAME) {
+		memcpy(frame->pixels, payload, len);
+	} else {
+		led_show_apply_delta((uint8_t*)frame->pixels, len, payload, hdr->length);
+	}
+	s->pos = payload + LED_SHOW_PAD(hdr->length);
+	s->frame++;
+	/* Scale the recorded timing to the current tempo */
+	return (uint64_t)hdr->duration * led_get_period_us() / show->period;
+}
+
+void led_show_record(const led_frame_t* frame)
+{
+	const uint8_t* buf = (const uint8_t*)frame->pixels;
+	printf("SHOW %u %u %u ", esp_log_timestamp(), led_get_period(), frame->num);
+	for (uint32_t i = 0; i < frame->num * sizeof(led_rgb_t); i++) {
+		printf("%02x", buf[i]);
+	}
+	printf("\n");
+}
@@ -0,0 +1,53 @@
+#ifndef LED_SHOW_H
+#define LED_SHOW_H
+#include <stdint.h>
+#include "led_frame.h"
+
+/*
+ * Pre-rendered shows live in the "show" data partition as a frame stream:
+ * a led_show_header_t followed by num_frames records. Each record is a
+ * led_show_frame_t followed by its payload, padded to a multiple of 4 bytes.
+ *
+ * Keyframes carry a whole frame (num_leds * bytes_per_led bytes, RGB order,
+ * so bytes_per_led is always 3). Delta frames are run-length coded XOR against the
+ * previous frame: a control byte with the top bit set is followed by
+ * (ctrl & 0x7f) + 1 bytes to XOR in, otherwise (ctrl + 1) bytes are unchanged.
+ *
+ * All fields are little endian. tools/show_encode.py produces this format.
+ */
+#define LED_SHOW_MAGIC		0x584c4254	/* "TBLX" */
+#define LED_SHOW_VERSION	2
+#define LED_SHOW_PARTITION	"show"
+
+typedef enum {
+	LED_SHOW_KEYFRAME	= 0,
+	LED_SHOW_DELTA		= 1,
+} led_show_frame_type_t;
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint8_t bytes_per_led;
+	uint8_t reserved;
+	uint32_t num_leds;
+	uint32_t num_frames;
+	uint32_t period;	/* LED period in ms when the show was recorded */
+} led_show_header_t;
+
+typedef struct {
+	uint8_t type;
+	uint8_t reserved;
+	uint16_t duration;	/* ms, at the recorded period */
+	uint32_t length;	/* payload bytes, before padding */
+} led_show_frame_t;
+
+typedef struct {
+	const uint8_t* pos;
+	uint32_t frame;
+} led_show_state_t;
+
+void pat_show_init(led_frame_t* frame, void* state);
+uint32_t pat_show(led_frame_t* frame, void* state);
+void led_show_record(const led_frame_t* frame);
+
+#endif /* LED_SHOW_H */
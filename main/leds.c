@@ -1,33 +1,173 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_intr_alloc.h"
+#include "esp_rom_crc.h"
 #include "driver/rmt.h"
+#include "driver/spi_master.h"
+#include "led_strip.h"
 
+#include "fixed.h"
+#include "latency.h"
+#include "led_dither.h"
+#include "led_layers.h"
+#include "led_matrix.h"
 #include "led_patterns.h"
+#include "led_show.h"
 #include "leds.h"
+#include "palette.h"
+#include "power.h"
+#include "rng.h"
+#include "scene.h"
+#include "sync.h"
+#include "sysmon.h"
+#include "trace.h"
 
 #define TAG "LEDs"
 #define RMT_TX_CHANNEL RMT_CHANNEL_0
+#define LED_SPI_HOST VSPI_HOST
+#define LED_SPI_DMA_CHAN 1
 
-static bool do_stop = false;
-static led_pattern_t* cur_pattern;
+#if CONFIG_LED_STRIP_WS2811
+#define LED_STRIP_TYPE LED_STRIP_WS2811
+#elif CONFIG_LED_STRIP_WS2815
+#define LED_STRIP_TYPE LED_STRIP_WS2815
+#elif CONFIG_LED_STRIP_SK6812_RGBW
+#define LED_STRIP_TYPE LED_STRIP_SK6812_RGBW
+#elif CONFIG_LED_STRIP_APA102
+#define LED_STRIP_TYPE LED_STRIP_APA102
+#elif CONFIG_LED_STRIP_SK9822
+#define LED_STRIP_TYPE LED_STRIP_SK9822
+#else
+#define LED_STRIP_TYPE LED_STRIP_WS2812
+#endif
+
+#if CONFIG_LED_STRIP_ORDER_RGB
+#define LED_STRIP_ORDER LED_STRIP_ORDER_RGB
+#elif CONFIG_LED_STRIP_ORDER_RBG
+#define LED_STRIP_ORDER LED_STRIP_ORDER_RBG
+#elif CONFIG_LED_STRIP_ORDER_GRB
+#define LED_STRIP_ORDER LED_STRIP_ORDER_GRB
+#elif CONFIG_LED_STRIP_ORDER_GBR
+#define LED_STRIP_ORDER LED_STRIP_ORDER_GBR
+#elif CONFIG_LED_STRIP_ORDER_BRG
+#define LED_STRIP_ORDER LED_STRIP_ORDER_BRG
+#elif CONFIG_LED_STRIP_ORDER_BGR
+#define LED_STRIP_ORDER LED_STRIP_ORDER_BGR
+#else
+#define LED_STRIP_ORDER LED_STRIP_ORDER_DEFAULT
+#endif
+#define LED_PALETTE_BLEND_MS	500
+#define LED_RMT_INTR_FLAGS	(1 << CONFIG_LED_RMT_INTR_LEVEL)	/* ESP_INTR_FLAG_LEVELn */
+#ifdef CONFIG_LED_RMT_INTR_CORE
+#define LED_RMT_INTR_CORE	CONFIG_LED_RMT_INTR_CORE
+#else
+#define LED_RMT_INTR_CORE	(-1)
+#endif
+#define LED_BENCH_FRAMES	100
+#define LED_TASK_STACK		4096
+#define LED_CONTROL_QUEUE_LEN	16
+#define LED_RENDER_CHECK_SEED	0x7b1c5eed
+/* x / 60 for x up to 255 * 60 without a divide */
+#define LED_DIV60(x)		(((x) * 69906u) >> 22)
+#if CONFIG_LED_INTERPOLATE
+#define LED_INTERP_FRAME_US	(1000000 / CONFIG_LED_INTERPOLATE_FPS)
+#endif
+#if CONFIG_LED_DITHER
+#define LED_DITHER_FRAME_US	(1000000 / CONFIG_LED_DITHER_FPS)
+#endif
+#if CONFIG_LED_CURRENT_LIMIT
+#define LED_CURRENT_RELEASE	4	/* steps of 1/255 per frame the scale comes back up by */
+#endif
+
+static TaskHandle_t led_task = NULL;
+static QueueHandle_t control_queue = NULL;
+static led_frame_t out;
+static uint32_t frames = 0;
+#if CONFIG_LED_POWER_SAVE
+/* Static patterns don't need sending again, the strip keeps showing them */
+static uint32_t out_crc = 0;
+static bool out_sent = false;
+#endif
+#if CONFIG_LED_CURRENT_LIMIT
+/* Frames are scaled by current_scale / 255 to keep the estimated draw in the budget */
+static uint8_t current_scale = 255;
+static uint32_t current_ma = 0;
+#endif
+#if CONFIG_LED_DITHER
+/* The frame at 16 bits without the intensity, out gets it quantised for each refresh */
+static uint16_t* deep;
+static uint8_t* dither_err;
+/* Eases towards the intensity, 0 - LED_DITHER_LEVEL_MAX */
+static uint32_t dither_level = 0;
+static bool dithering = false;
+#endif
+#if CONFIG_LED_INTERPOLATE
+/* The strip fades from key_from to key_to between key_start and key_end */
+#if CONFIG_LED_DITHER
+static uint16_t* key_from;
+#else
+static led_frame_t key_from;
+#endif
+static led_frame_t key_to;
+static int64_t key_start;
+static int64_t key_end;
+#endif
+#if CONFIG_LED_MATRIX
+/* Patterns draw the wall row-major, the output puts each pixel where it is wired */
+static led_matrix_t matrix;
+#endif
+#if CONFIG_LED_RENDER_CHECK
+/* The render check runs patterns on a clock of its own */
+static bool virtual_clock = false;
+static int64_t virtual_now;
+#endif
+#if CONFIG_LED_STATIC_ALLOC
+static led_rgb_t out_pixels[CONFIG_NUM_LEDS];
+#if CONFIG_LED_MATRIX
+static uint16_t matrix_map[CONFIG_NUM_LEDS];
+#endif
+#if CONFIG_LED_DITHER
+static uint16_t deep_channels[3 * CONFIG_NUM_LEDS];
+static uint8_t dither_err_channels[3 * CONFIG_NUM_LEDS];
+#endif
+#if CONFIG_LED_INTERPOLATE
+#if CONFIG_LED_DITHER
+static uint16_t key_from_channels[3 * CONFIG_NUM_LEDS];
+static led_rgb_t key_pixels[CONFIG_NUM_LEDS];
+#else
+static led_rgb_t key_pixels[2 * CONFIG_NUM_LEDS];
+#endif
+#endif
+#if CONFIG_LED_STRIP_CLOCKED
+static DMA_ATTR uint8_t strip_storage[LED_STRIP_SPI_STORAGE_SIZE(CONFIG_NUM_LEDS)];
+#else
+static DMA_ATTR uint8_t strip_storage[LED_STRIP_RMT_STORAGE_SIZE(CONFIG_NUM_LEDS)];
+#endif
+#endif
 static uint32_t hue = 0;		/* 0-360 */
 static uint32_t hue2 = 180;		/* 0-360 */
 static uint8_t intensity = 42;		/* 0-100 */
-static uint32_t period = 200;		/* milliseconds */
-
-bool led_should_stop()
-{
-	if (do_stop) {
-		do_stop = false;
-		return true;
-	}
-	return false;
-}
+static uint32_t period_us = 200000;	/* microseconds */
+static uint8_t palette_sel = 0;		/* index into get_gradients() */
+static bool palette_dirty = true;
+static bool palette_blending = false;
+static int64_t palette_time;
+static palette_t palette;
+static palette_t palette_target;
 
 void led_set_primary_hue(uint32_t new)
 {
+	LATENCY_MARK(LATENCY_APPLIED);
 	hue = new % 360;
+	palette_dirty = true;
 }
 
 uint32_t led_get_primary_hue()
@@ -37,7 +177,9 @@ uint32_t led_get_primary_hue()
 
 void led_set_secondary_hue(uint32_t new)
 {
+	LATENCY_MARK(LATENCY_APPLIED);
 	hue2 = new % 360;
+	palette_dirty = true;
 }
 
 uint32_t led_get_secondary_hue()
@@ -48,7 +190,14 @@ uint32_t led_get_secondary_hue()
 void led_set_intensity(uint8_t new)
 {
 	if (new <= 100) {
+		LATENCY_MARK(LATENCY_APPLIED);
 		intensity = new;
+#if CONFIG_LED_DITHER
+		/* The next refreshes fade to it, patterns don't render with it */
+		dithering = true;
+#else
+		palette_dirty = true;
+#endif
 	}
 }
 
@@ -57,25 +206,215 @@ uint8_t led_get_intensity()
 	return intensity;
 }
 
+/* What patterns render at, with CONFIG_LED_DITHER the intensity is applied on output instead */
+uint8_t led_get_render_intensity()
+{
+#if CONFIG_LED_DITHER
+	return 100;
+#else
+	return intensity;
+#endif
+}
+
+/* Microseconds on the clock shared with other units, or since boot when there are none */
+int64_t led_get_time()
+{
+#if CONFIG_LED_RENDER_CHECK
+	if (virtual_clock) {
+		return virtual_now;
+	}
+#endif
+#if CONFIG_LED_SYNC
+	return esp_timer_get_time() + sync_get_offset();
+#else
+	return esp_timer_get_time();
+#endif
+}
+
+void led_set_layer_params(uint8_t layer, const led_layer_params_t* params)
+{
+	LATENCY_MARK(LATENCY_APPLIED);
+	led_layer_set(layer, params);
+	if (led_task) {
+		xTaskNotifyGive(led_task);
+	}
+}
+
+void led_get_layer_params(uint8_t layer, led_layer_params_t* params)
+{
+	led_layer_get(layer, params);
+}
+
+void led_set_layer(uint8_t layer, led_pattern_t* pattern, led_blend_t blend, uint8_t opacity)
+{
+	led_layer_params_t params = {
+		.pattern = pattern,
+		.blend = blend,
+		.opacity = opacity,
+		.start = led_get_time(),
+	};
+	led_set_layer_params(layer, &params);
+}
+
+led_pattern_t* led_get_layer(uint8_t layer)
+{
+	led_layer_params_t params;
+	led_layer_get(layer, &params);
+	return params.pattern;
+}
+
+/* Every zone, see led_set_layer() for a single one */
 void led_set_pattern(led_pattern_t* pattern)
 {
-	do_stop = true;
-	cur_pattern = pattern;
+	for (uint8_t z = 0; z < LED_NUM_ZONES; z++) {
+		led_set_layer(z, pattern, LED_BLEND_ALPHA, 255);
+	}
 }
 
 led_pattern_t* led_get_pattern()
 {
-	return cur_pattern;
+	return led_get_layer(0);
+}
+
+void led_set_palette(uint8_t new)
+{
+	if (new < PALETTE_NUM_GRADIENTS) {
+		LATENCY_MARK(LATENCY_APPLIED);
+		palette_sel = new;
+		palette_dirty = true;
+	}
+}
+
+uint8_t led_get_palette_index()
+{
+	return palette_sel;
+}
+
+/* Only call this from the LED task, it rebuilds the table when parameters change */
+const palette_t* led_get_palette()
+{
+	int64_t now = led_get_time();
+	if (palette_dirty) {
+		palette_dirty = false;
+		const palette_gradient_t* grad = &get_gradients()[palette_sel];
+		if (grad->stops) {
+			palette_fill_gradient(&palette_target, grad->stops, grad->num_stops, led_get_render_intensity());
+		} else {
+			/* There and back again, so the table wraps around seamlessly */
+			int32_t span = (hue2 + 360 - hue) % 360;
+			uint8_t v = led_get_render_intensity();
+			palette_fill_hsv(&palette_target, 0, 127, hue, hue + span, v, v);
+			palette_fill_hsv(&palette_target, 128, 255, hue + span, hue, v, v);
+		}
+		if (!palette_blending) {
+			palette_blending = true;
+			palette_time = now;
+		}
+	}
+	if (palette_blending) {
+		int64_t amount = ((now - palette_time) * 256) / (LED_PALETTE_BLEND_MS * 1000);
+		if (amount < 0) {
+			/* The shared clock stepped back */
+			palette_time = now;
+		} else if (amount) {
+			palette_time = now;
+			palette_blending = palette_blend(&palette, &palette_target, (amount > 255) ? 255 : amount);
+		}
+	}
+	return &palette;
 }
 
 void led_set_period(uint32_t new)
 {
-	period = new;
+	led_set_period_us(new * 1000);
 }
 
 uint32_t led_get_period()
 {
-	return period;
+	return period_us / 1000;
+}
+
+void led_set_period_us(uint32_t new)
+{
+	/* Patterns divide by the period in ms */
+	if (new >= 1000) {
+		LATENCY_MARK(LATENCY_APPLIED);
+		period_us = new;
+	}
+}
+
+uint32_t led_get_period_us()
+{
+	return period_us;
+}
+
+uint32_t led_get_overruns()
+{
+	return led_layers_overruns();
+}
+
+uint32_t led_get_frames()
+{
+	return frames;
+}
+
+#if CONFIG_LED_CURRENT_LIMIT
+/* Estimated draw of the last frame sent, after limiting */
+uint32_t led_get_current_ma()
+{
+	return current_ma;
+}
+#endif
+
+/* Queue a change for the LED task to make before its next frame, never blocks */
+bool led_control(const led_control_t* ctl)
+{
+	if (!control_queue || xQueueSend(control_queue, ctl, 0) != pdTRUE) {
+		return false;
+	}
+	xTaskNotifyGive(led_task);
+	return true;
+}
+
+static void led_control_apply(const led_control_t* ctl)
+{
+	switch (ctl->param) {
+	case LED_CONTROL_HUE:
+		led_set_primary_hue(ctl->value);
+		break;
+	case LED_CONTROL_HUE2:
+		led_set_secondary_hue(ctl->value);
+		break;
+	case LED_CONTROL_INTENSITY:
+		led_set_intensity(ctl->value);
+		break;
+	case LED_CONTROL_PERIOD:
+		led_set_period_us(ctl->value);
+		break;
+	case LED_CONTROL_PALETTE:
+		led_set_palette(ctl->value);
+		break;
+	case LED_CONTROL_PATTERN:
+		if (ctl->value < 0 || ctl->value >= LED_NUM_PATTERNS) {
+			led_set_layer(ctl->layer, NULL, LED_BLEND_ALPHA, 255);
+		} else {
+			led_set_layer(ctl->layer, &get_patterns()[ctl->value],
+				      (ctl->layer >= LED_NUM_ZONES) ? LED_BLEND_SCREEN : LED_BLEND_ALPHA, 255);
+		}
+		break;
+	case LED_CONTROL_RESTART:
+		for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+			led_layer_params_t params;
+			led_layer_get(l, &params);
+			if (params.pattern) {
+				params.start = led_get_time();
+				led_layer_set(l, &params);
+			}
+		}
+		break;
+	default:
+		break;
+	}
 }
 
 uint32_t led_get_num()
@@ -84,6 +423,13 @@ uint32_t led_get_num()
 	return CONFIG_NUM_LEDS;
 }
 
+#if CONFIG_LED_MATRIX
+const led_matrix_t* led_get_matrix()
+{
+	return &matrix;
+}
+#endif
+
 /**
  * @brief Simple helper function, converting HSV color space to RGB color space
  *
@@ -92,15 +438,17 @@ uint32_t led_get_num()
  */
 void led_strip_hsv2rgb(uint32_t h, uint8_t s, uint8_t v, uint8_t* r, uint8_t* g, uint8_t* b)
 {
-	h %= 360; // h -> [0,360]
-	uint32_t rgb_max = v * 2.55f;
-	uint32_t rgb_min = rgb_max * (100 - s) / 100.0f;
+	if (h >= 360) {
+		h %= 360;
+	}
+	uint32_t rgb_max = percent8(v);
+	uint32_t rgb_min = scale8(rgb_max, percent8(100 - s));
 
-	uint32_t i = h / 60;
-	uint32_t diff = h % 60;
+	uint32_t i = LED_DIV60(h);
+	uint32_t diff = h - i * 60;
 
 	// RGB adjustment amount by hue
-	uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
+	uint32_t rgb_adj = LED_DIV60((rgb_max - rgb_min) * diff);
 
 	switch (i) {
 	case 0:
@@ -136,34 +484,543 @@ void led_strip_hsv2rgb(uint32_t h, uint8_t s, uint8_t v, uint8_t* r, uint8_t* g,
 	}
 }
 
+/* Hand the frame to the strip driver scaled */
+static void led_encode(led_strip_t* strip, uint8_t scale)
+{
+	for (uint32_t i = 0; i < out.num; i++) {
+#if CONFIG_LED_MATRIX
+		uint32_t index = matrix.map[i];
+#else
+		uint32_t index = i;
+#endif
+		led_rgb_t c = out.pixels[i];
+		if (scale != 255) {
+			c = led_rgb_scale(c, scale);
+		}
+		ESP_ERROR_CHECK(strip->set_pixel(strip, index, c.r, c.g, c.b));
+	}
+}
+
+#if CONFIG_LED_CURRENT_LIMIT
+/*
+ * The draw is estimated from the sum of the frame's channel values before
+ * it's encoded, so the frame only goes to the strip driver once, at the
+ * scale that fits. A frame over the budget drops the scale at once, it
+ * comes back up gradually so it doesn't pump. Returns the scale to send at.
+ */
+static uint8_t led_current_limit(void)
+{
+	uint32_t sum = 0;
+	for (uint32_t i = 0; i < out.num; i++) {
+		sum += out.pixels[i].r + out.pixels[i].g + out.pixels[i].b;
+	}
+	uint32_t idle_ma = out.num * CONFIG_LED_CURRENT_IDLE_UA / 1000;
+	uint32_t budget = (CONFIG_LED_CURRENT_BUDGET_MA > idle_ma) ?
+		(CONFIG_LED_CURRENT_BUDGET_MA - idle_ma) * 255 / CONFIG_LED_CURRENT_CHANNEL_MA : 0;
+	uint32_t allowed = (sum > budget) ? budget * 255 / sum : 255;
+	if (allowed < current_scale) {
+		current_scale = allowed;
+	} else {
+		current_scale = (allowed - current_scale > LED_CURRENT_RELEASE) ?
+			current_scale + LED_CURRENT_RELEASE : allowed;
+	}
+	current_ma = idle_ma + sum * current_scale / 255 * CONFIG_LED_CURRENT_CHANNEL_MA / 255;
+	return current_scale;
+}
+#endif
+
+static void led_output(led_strip_t* strip)
+{
+#if CONFIG_LED_POWER_SAVE
+#if CONFIG_LED_CURRENT_LIMIT
+	/* The same pixels at another scale are a new frame */
+	uint32_t crc = esp_rom_crc32_le(current_scale, (const uint8_t*)out.pixels, out.num * sizeof(led_rgb_t));
+#else
+	uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)out.pixels, out.num * sizeof(led_rgb_t));
+#endif
+	if (out_sent && crc == out_crc) {
+		return;
+	}
+	out_crc = crc;
+	out_sent = true;
+#endif
+#if CONFIG_LED_CURRENT_LIMIT
+	led_encode(strip, led_current_limit());
+#else
+	led_encode(strip, 255);
+#endif
+	TRACE_BEGIN(TRACE_ID_REFRESH);
+	ESP_ERROR_CHECK(strip->refresh(strip, 0));
+	TRACE_END(TRACE_ID_REFRESH);
+	LATENCY_MARK(LATENCY_LIT);
+	if (!frames) {
+		/* esp_timer starts with the app, the bootloader comes on top */
+		ESP_LOGI(TAG, "First frame out %lld us after boot", esp_timer_get_time());
+	}
+#if !CONFIG_LED_STRIP_CLOCKED
+	led_strip_rmt_stats_t stats;
+	if (led_strip_rmt_get_stats(strip, &stats) == ESP_OK) {
+		ESP_LOGD(TAG, "%u refills, %u us in ISR", stats.translator_calls,
+			 stats.translator_cycles / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+	}
+#endif
+#if CONFIG_LED_SHOW_RECORD
+	led_show_record(&out);
+#endif
+}
+
+#if CONFIG_LED_DITHER
+/*
+ * Quantise deep into out for the next refresh, with the intensity easing
+ * towards where it was set. Returns false once more refreshes of the same
+ * frame would show nothing new.
+ */
+static bool led_dither_frame(void)
+{
+	int32_t target = (uint32_t)intensity * LED_DITHER_LEVEL_MAX / 100;
+	int32_t step = (target - (int32_t)dither_level) / 8;
+	dither_level = step ? dither_level + step : target;
+	bool inexact = led_dither_quantise((uint8_t*)out.pixels, deep, dither_err, out.num * 3, dither_level);
+	return inexact || dither_level != target;
+}
+#endif
+
+#if CONFIG_LED_INTERPOLATE
+#if CONFIG_LED_DITHER
+/* Blend the two keyframes into deep in one pass, returns false once it shows key_to */
+static bool led_interp_frame(int64_t now)
+{
+	const uint8_t* b = (const uint8_t*)key_to.pixels;
+	uint32_t len = out.num * 3;
+	if (now >= key_end) {
+		led_dither_expand(deep, b, len);
+		return false;
+	}
+	uint16_t frac = ((now - key_start) << 16) / (key_end - key_start);
+	for (uint32_t i = 0; i < len; i++) {
+		deep[i] = lerp16(key_from[i], b[i] << 8, frac);
+	}
+	return true;
+}
+#else
+/* Blend the two keyframes into out in one pass, returns false once it shows key_to */
+static bool led_interp_frame(int64_t now)
+{
+	const uint8_t* a = (const uint8_t*)key_from.pixels;
+	const uint8_t* b = (const uint8_t*)key_to.pixels;
+	uint8_t* o = (uint8_t*)out.pixels;
+	uint32_t len = out.num * sizeof(led_rgb_t);
+	if (now >= key_end) {
+		memcpy(o, b, len);
+		return false;
+	}
+	uint8_t frac = ((now - key_start) << 8) / (key_end - key_start);
+	for (uint32_t i = 0; i < len; i++) {
+		o[i] = lerp8(a[i], b[i], frac);
+	}
+	return true;
+}
+#endif
+
+/*
+ * The layers have rendered a new keyframe, which the strip reaches by end.
+ * The fade starts from where the last one had got to by now, so a keyframe
+ * that comes early doesn't make the strip jump.
+ */
+static void led_interp_key(int64_t now, int64_t end)
+{
+	led_interp_frame(now);
+#if CONFIG_LED_DITHER
+	memcpy(key_from, deep, out.num * 3 * sizeof(uint16_t));
+#else
+	memcpy(key_from.pixels, out.pixels, out.num * sizeof(led_rgb_t));
+#endif
+	led_layers_composite(&key_to);
+	key_start = now;
+	key_end = (end == INT64_MAX) ? now : end;
+}
+#endif
+
+static void led_frame_timer(void* arg)
+{
+	xTaskNotifyGive((TaskHandle_t)arg);
+}
+
+/* Frames are paced by esp_timer in microseconds, not by the scheduler tick */
 void led_loop(void* parameters)
 {
 	led_strip_t* strip = (led_strip_t*)parameters;
+	esp_timer_handle_t frame_timer;
+	esp_timer_create_args_t timer_args = {
+		.callback = led_frame_timer,
+		.arg = xTaskGetCurrentTaskHandle(),
+		.name = "LED frame",
+	};
+	int64_t next;
+	int64_t wake;
+	led_control_t ctl;
+	/* Changes waiting for a frame to show them */
+	led_control_t pending[LED_CONTROL_QUEUE_LEN];
+	uint8_t num_pending = 0;
+#if CONFIG_LED_SYNC && CONFIG_LED_INTERPOLATE
+	int64_t offset = sync_get_offset();
+#endif
+#if CONFIG_LED_INTERPOLATE
+	bool fading = false;
+#endif
+#if CONFIG_LED_TRACE
+	uint32_t overruns = 0;
+#endif
 
-	// Show simple rainbow chasing pattern
+	ESP_ERROR_CHECK(esp_timer_create(&timer_args, &frame_timer));
 	ESP_LOGI(TAG, "LED Thread Start");
 	while (true) {
-		ESP_LOGI(TAG, "Starting pattern %s", cur_pattern->name);
-		cur_pattern->start(strip);
+#if CONFIG_LED_SYNC && CONFIG_LED_INTERPOLATE
+		/* The sync task moves the layers when its clock jumps, the fade is moved here */
+		int64_t jump = sync_get_offset() - offset;
+		if (jump > SYNC_STEP_US || jump < -SYNC_STEP_US) {
+			key_start += jump;
+			key_end += jump;
+		}
+		offset += jump;
+#endif
+		/* Leave the rest queued if too many are waiting for a frame */
+		while (num_pending < LED_CONTROL_QUEUE_LEN && xQueueReceive(control_queue, &ctl, 0) == pdTRUE) {
+			led_control_apply(&ctl);
+			if (ctl.done) {
+				pending[num_pending++] = ctl;
+			}
+		}
+#if CONFIG_LED_POWER_SAVE
+		int64_t start = led_get_time();
+		power_render_begin();
+#endif
+		TRACE_BEGIN(TRACE_ID_FRAME);
+		bool rendered = led_layers_render(led_get_time(), &next);
+#if CONFIG_LED_LATENCY
+		if (rendered) {
+			LATENCY_MARK(LATENCY_RENDERED);
+		}
+#endif
+#if CONFIG_LED_TRACE
+		if (led_layers_overruns() != overruns) {
+			overruns = led_layers_overruns();
+			trace_dump_request();
+		}
+#endif
+#if CONFIG_LED_DITHER
+		bool fresh = rendered;
+#endif
+#if CONFIG_LED_INTERPOLATE
+		/* Patterns render keyframes at their own pace, the strip fades between them at full rate */
+		int64_t now = led_get_time();
+		if (rendered) {
+			led_interp_key(now, next);
+			fading = true;
+		}
+		wake = next;
+		if (fading) {
+			fading = led_interp_frame(now);
+#if CONFIG_LED_DITHER
+			fresh = true;
+#else
+			led_output(strip);
+			frames++;
+#endif
+			if (fading && now + LED_INTERP_FRAME_US < next) {
+				wake = now + LED_INTERP_FRAME_US;
+			}
+		}
+#else
+		if (rendered) {
+			led_layers_composite(&out);
+#if CONFIG_LED_DITHER
+			led_dither_expand(deep, (const uint8_t*)out.pixels, out.num * 3);
+#else
+			led_output(strip);
+			frames++;
+#endif
+		}
+		wake = next;
+#endif
+#if CONFIG_LED_DITHER
+		/* Refresh at full rate while the strip sits between two 8-bit levels */
+		if (fresh || dithering) {
+			dithering = led_dither_frame();
+			led_output(strip);
+			frames++;
+			int64_t soon = led_get_time() + LED_DITHER_FRAME_US;
+			if (dithering && soon < wake) {
+				wake = soon;
+			}
+		}
+#endif
+		TRACE_END(TRACE_ID_FRAME);
+#if CONFIG_LED_POWER_SAVE
+		power_render_end(led_get_time() - start, wake - start);
+#endif
+		if (num_pending && (rendered || next == INT64_MAX)) {
+			int64_t now = esp_timer_get_time();
+			for (uint8_t i = 0; i < num_pending; i++) {
+				pending[i].done(pending[i].arg, now - pending[i].time);
+			}
+			num_pending = 0;
+		}
+		if (wake != INT64_MAX) {
+			int64_t wait = wake - led_get_time();
+			if (wait <= 0) {
+				continue;
+			}
+			ESP_ERROR_CHECK(esp_timer_start_once(frame_timer, wait));
+		}
+		/* Pattern changes and controls wake us up early */
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		esp_timer_stop(frame_timer);
 	}
 }
 
-int led_init(void)
+#if !CONFIG_LED_STRIP_CLOCKED
+static led_strip_t* led_strip_rmt_init(uint8_t mem_blocks)
 {
-	rmt_config_t config = RMT_DEFAULT_CONFIG_TX(CONFIG_RMT_TX_GPIO, RMT_TX_CHANNEL);
-	config.clk_div = 2;
+	led_strip_config_t strip_config = LED_STRIP_DEFAULT_CONFIG(CONFIG_NUM_LEDS, (led_strip_dev_t)RMT_TX_CHANNEL);
+	strip_config.type = LED_STRIP_TYPE;
+	strip_config.order = LED_STRIP_ORDER;
+	strip_config.gpio_num = CONFIG_RMT_TX_GPIO;
+	strip_config.mem_block_num = mem_blocks;
+	strip_config.intr_flags = LED_RMT_INTR_FLAGS;
+	strip_config.intr_core = LED_RMT_INTR_CORE;
+#if CONFIG_LED_STATIC_ALLOC
+	strip_config.storage = strip_storage;
+	strip_config.storage_size = sizeof(strip_storage);
+#endif
+	return led_strip_new_rmt(&strip_config);
+}
 
-	ESP_ERROR_CHECK(rmt_config(&config));
-	ESP_ERROR_CHECK(rmt_driver_install(config.channel, 0, 0));
+#if CONFIG_LED_RMT_BENCHMARK
+/* Time a gradient through the strip at each memory block count */
+static void led_rmt_benchmark(void)
+{
+	for (uint8_t blocks = 1; blocks <= 8; blocks <<= 1) {
+		led_strip_t* strip = led_strip_rmt_init(blocks);
+		led_strip_rmt_stats_t stats;
+		ESP_ERROR_CHECK(strip ? ESP_OK : ESP_FAIL);
+		for (uint32_t i = 0; i < CONFIG_NUM_LEDS; i++) {
+			ESP_ERROR_CHECK(strip->set_pixel(strip, i, i, 255 - i, i ^ 0x55));
+		}
+		int64_t start = esp_timer_get_time();
+		for (uint32_t i = 0; i < LED_BENCH_FRAMES; i++) {
+			ESP_ERROR_CHECK(strip->refresh(strip, 100));
+		}
+		int64_t elapsed = esp_timer_get_time() - start;
+		ESP_ERROR_CHECK(led_strip_rmt_get_stats(strip, &stats));
+		ESP_LOGI(TAG, "%u RMT blocks: %u refills, %u us in ISR, %u us per frame", blocks,
+			 stats.translator_calls, stats.translator_cycles / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+			 (uint32_t)(elapsed / LED_BENCH_FRAMES));
+		ESP_ERROR_CHECK(strip->clear(strip, 100));
+		ESP_ERROR_CHECK(strip->del(strip));
+	}
+}
+#endif
+#endif
+
+static led_strip_t* led_strip_init(void)
+{
+#if CONFIG_LED_STRIP_CLOCKED
+	spi_bus_config_t bus_config = {
+		.mosi_io_num = CONFIG_RMT_TX_GPIO,
+		.miso_io_num = -1,
+		.sclk_io_num = CONFIG_LED_CLK_GPIO,
+		.quadwp_io_num = -1,
+		.quadhd_io_num = -1,
+		.max_transfer_sz = LED_STRIP_SPI_TRANSFER_SIZE(CONFIG_NUM_LEDS),
+	};
+	spi_device_interface_config_t dev_config = {
+		.mode = 0,
+		.clock_speed_hz = CONFIG_LED_SPI_MHZ * 1000000,
+		.spics_io_num = -1,
+		.queue_size = 1,
+	};
+	spi_device_handle_t spi;
+
+	ESP_ERROR_CHECK(spi_bus_initialize(LED_SPI_HOST, &bus_config, LED_SPI_DMA_CHAN));
+	ESP_ERROR_CHECK(spi_bus_add_device(LED_SPI_HOST, &dev_config, &spi));
+
+	led_strip_config_t strip_config = LED_STRIP_DEFAULT_CONFIG(CONFIG_NUM_LEDS, (led_strip_dev_t)spi);
+	strip_config.type = LED_STRIP_TYPE;
+	strip_config.order = LED_STRIP_ORDER;
+#if CONFIG_LED_STATIC_ALLOC
+	strip_config.storage = strip_storage;
+	strip_config.storage_size = sizeof(strip_storage);
+#endif
+	return led_strip_new_spi_apa102(&strip_config);
+#else
+	return led_strip_rmt_init(CONFIG_LED_RMT_MEM_BLOCKS);
+#endif
+}
+
+#if CONFIG_LED_RENDER_CHECK
+/*
+ * Render every pattern through the layers for a while on a virtual clock,
+ * as fast as they go, and print a checksum of every frame and the frame
+ * rate reached for tools/render_check.py. Runs before the LED task starts.
+ * Zone z runs pattern p + z, so every pattern is checked in every zone.
+ */
+static void led_render_check(void)
+{
+	led_layer_params_t params = {
+		.blend = LED_BLEND_ALPHA,
+		.opacity = 255,
+	};
+	palette_t initial = palette;
+
+	rng_set_default_seed(LED_RENDER_CHECK_SEED);
+	virtual_clock = true;
+	for (uint8_t p = 0; p < LED_NUM_PATTERNS; p++) {
+		int64_t next = 0;
+		int64_t busy = 0;
+		uint32_t num = 0;
+		/* Every pattern starts from the same palette fade */
+		palette = initial;
+		palette_dirty = true;
+		palette_blending = false;
+		virtual_now = 0;
+		for (uint8_t z = 0; z < LED_NUM_ZONES; z++) {
+			params.pattern = &get_patterns()[(p + z) % LED_NUM_PATTERNS];
+			led_layer_set(z, &params);
+		}
+		params.pattern = &get_patterns()[p];
+		while (virtual_now < CONFIG_LED_RENDER_CHECK_SECONDS * 1000000LL) {
+			int64_t start = esp_timer_get_time();
+			bool rendered = led_layers_render(virtual_now, &next);
+			if (rendered) {
+				led_layers_composite(&out);
+			}
+			busy += esp_timer_get_time() - start;
+			if (rendered) {
+				printf("RENDER %u %u %lld %08x", p, num++, virtual_now,
+				       esp_rom_crc32_le(0, (const uint8_t*)out.pixels, out.num * sizeof(led_rgb_t)));
+#if CONFIG_LED_RENDER_CHECK_PIXELS
+				printf(" ");
+				for (uint32_t i = 0; i < out.num * sizeof(led_rgb_t); i++) {
+					printf("%02x", ((const uint8_t*)out.pixels)[i]);
+				}
+#endif
+				printf("\n");
+			}
+			if (next == INT64_MAX) {
+				break;
+			}
+			virtual_now = next;
+		}
+		printf("RENDER_DONE %u %u %lld %s\n", p, num, busy, params.pattern->name);
+	}
+	virtual_clock = false;
+	palette = initial;
+	palette_dirty = true;
+	palette_blending = false;
+	rng_set_default_seed(CONFIG_LED_RNG_SEED);
+}
+#endif
 
-	led_strip_config_t strip_config = LED_STRIP_DEFAULT_CONFIG(CONFIG_NUM_LEDS, (led_strip_dev_t)config.channel);
-	led_strip_t* strip = led_strip_new_rmt_ws2812(&strip_config);
+int led_init(void)
+{
+#if CONFIG_LED_RMT_BENCHMARK
+	led_rmt_benchmark();
+#endif
+	led_strip_t* strip = led_strip_init();
+	ESP_ERROR_CHECK(strip ? ESP_OK : ESP_FAIL);
 
 	ESP_ERROR_CHECK(strip->clear(strip, 100));
 
-	cur_pattern = &(get_patterns()[0]);
+	out.num = led_get_num();
+#if CONFIG_LED_STATIC_ALLOC
+	out.pixels = out_pixels;
+#else
+	out.pixels = calloc(out.num, sizeof(led_rgb_t));
+	ESP_ERROR_CHECK(out.pixels ? ESP_OK : ESP_ERR_NO_MEM);
+#endif
+#if CONFIG_LED_DITHER
+#if CONFIG_LED_STATIC_ALLOC
+	deep = deep_channels;
+	dither_err = dither_err_channels;
+#else
+	deep = calloc(out.num * 3, sizeof(uint16_t));
+	dither_err = malloc(out.num * 3);
+	ESP_ERROR_CHECK(deep && dither_err ? ESP_OK : ESP_ERR_NO_MEM);
+#endif
+	led_dither_seed(dither_err, out.num * 3);
+#endif
+#if CONFIG_LED_INTERPOLATE
+#if CONFIG_LED_DITHER
+#if CONFIG_LED_STATIC_ALLOC
+	key_from = key_from_channels;
+	key_to.pixels = key_pixels;
+#else
+	key_from = calloc(out.num * 3, sizeof(uint16_t));
+	key_to.pixels = calloc(out.num, sizeof(led_rgb_t));
+	ESP_ERROR_CHECK(key_from && key_to.pixels ? ESP_OK : ESP_ERR_NO_MEM);
+#endif
+#else
+#if CONFIG_LED_STATIC_ALLOC
+	key_from.pixels = key_pixels;
+#else
+	key_from.pixels = calloc(2 * out.num, sizeof(led_rgb_t));
+	ESP_ERROR_CHECK(key_from.pixels ? ESP_OK : ESP_ERR_NO_MEM);
+#endif
+	key_from.num = out.num;
+	key_to.pixels = &key_from.pixels[out.num];
+#endif
+	key_to.num = out.num;
+#endif
+#if CONFIG_LED_MATRIX
+	led_matrix_config_t matrix_config = {
+		.panel_width = CONFIG_LED_MATRIX_PANEL_WIDTH,
+		.panel_height = CONFIG_LED_MATRIX_PANEL_HEIGHT,
+		.panels_x = CONFIG_LED_MATRIX_PANELS_X,
+		.panels_y = CONFIG_LED_MATRIX_PANELS_Y,
+#if CONFIG_LED_MATRIX_VERTICAL
+		.vertical = true,
+#endif
+#if CONFIG_LED_MATRIX_SERPENTINE
+		.serpentine = true,
+#endif
+#if CONFIG_LED_MATRIX_TILES_SERPENTINE
+		.tiles_serpentine = true,
+#endif
+	};
+#if CONFIG_LED_STATIC_ALLOC
+	uint16_t* map = matrix_map;
+#else
+	uint16_t* map = calloc(out.num, sizeof(uint16_t));
+	ESP_ERROR_CHECK(map ? ESP_OK : ESP_ERR_NO_MEM);
+#endif
+	if (!led_matrix_init(&matrix, &matrix_config, map) || matrix.width * matrix.height != out.num) {
+		ESP_LOGE(TAG, "Matrix of %ux%u doesn't match %u LEDs", matrix.width, matrix.height, out.num);
+		ESP_ERROR_CHECK(ESP_ERR_INVALID_SIZE);
+	}
+#endif
+	led_layers_init(out.num);
+#if CONFIG_LED_RENDER_CHECK
+	led_render_check();
+#endif
+#if CONFIG_LED_STATIC_ALLOC
+	static StaticQueue_t control_queue_buf;
+	static uint8_t control_queue_storage[LED_CONTROL_QUEUE_LEN * sizeof(led_control_t)];
+	control_queue = xQueueCreateStatic(LED_CONTROL_QUEUE_LEN, sizeof(led_control_t),
+					   control_queue_storage, &control_queue_buf);
+#else
+	control_queue = xQueueCreate(LED_CONTROL_QUEUE_LEN, sizeof(led_control_t));
+#endif
+	ESP_ERROR_CHECK(control_queue ? ESP_OK : ESP_ERR_NO_MEM);
+	bool restored = false;
+#if CONFIG_LED_SCENE_RESTORE
+	restored = scene_restore();
+#endif
+	if (!restored) {
+		led_set_pattern(&(get_patterns()[0]));
+	}
 
-	xTaskCreatePinnedToCore(led_loop, "LED loop", 4096, strip, 2, NULL, 0);
+	SYSMON_TASK_CREATE(led_loop, "LED loop", LED_TASK_STACK, strip, 2, &led_task, 0);
 
 	return 0;
 }
@@ -4,22 +4,65 @@
 #include <stdint.h>
 #include "freertos/FreeRTOS.h"
 
+#include "led_layers.h"
+#include "led_matrix.h"
 #include "led_patterns.h"
+#include "palette.h"
+
+typedef enum {
+	LED_CONTROL_HUE,
+	LED_CONTROL_HUE2,
+	LED_CONTROL_INTENSITY,
+	LED_CONTROL_PERIOD,	/* us */
+	LED_CONTROL_PALETTE,
+	LED_CONTROL_PATTERN,	/* index into get_patterns(), -1 clears the layer */
+	LED_CONTROL_RESTART,	/* start every layer again from the top */
+} led_control_param_t;
+
+/* A parameter change for the LED task to apply before its next frame */
+typedef struct {
+	led_control_param_t param;
+	uint8_t layer;
+	int32_t value;
+	int64_t time;		/* esp_timer time the change was asked for */
+	/* optional, called from the LED task once a frame with the change is out */
+	void (*done)(void* arg, int64_t latency);
+	void* arg;
+} led_control_t;
 
 void led_strip_hsv2rgb(uint32_t h, uint8_t s, uint8_t v, uint8_t* r, uint8_t* g, uint8_t* b);
 
-bool led_should_stop(void);
 void led_set_primary_hue(uint32_t new);
 uint32_t led_get_primary_hue(void);
 void led_set_secondary_hue(uint32_t new);
 uint32_t led_get_secondary_hue(void);
 void led_set_intensity(uint8_t new);
 uint8_t led_get_intensity(void);
+uint8_t led_get_render_intensity(void);
 void led_set_pattern(led_pattern_t* pattern);
 led_pattern_t* led_get_pattern(void);
+void led_set_layer(uint8_t layer, led_pattern_t* pattern, led_blend_t blend, uint8_t opacity);
+led_pattern_t* led_get_layer(uint8_t layer);
+void led_set_layer_params(uint8_t layer, const led_layer_params_t* params);
+void led_get_layer_params(uint8_t layer, led_layer_params_t* params);
+void led_set_palette(uint8_t new);
+uint8_t led_get_palette_index(void);
+const palette_t* led_get_palette(void);
 void led_set_period(uint32_t new);
 uint32_t led_get_period(void);
+void led_set_period_us(uint32_t new);
+uint32_t led_get_period_us(void);
+uint32_t led_get_overruns(void);
 uint32_t led_get_num(void);
+#if CONFIG_LED_MATRIX
+const led_matrix_t* led_get_matrix(void);
+#endif
+int64_t led_get_time(void);
+uint32_t led_get_frames(void);
+#if CONFIG_LED_CURRENT_LIMIT
+uint32_t led_get_current_ma(void);
+#endif
+bool led_control(const led_control_t* ctl);
 
 int led_init(void);
 #endif /* LEDS_H */
@@ -2,8 +2,19 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 
+#include "control.h"
+#include "fixed.h"
+#include "latency.h"
 #include "leds.h"
 #include "led_patterns.h"
+#include "midi.h"
+#include "net.h"
+#include "palette.h"
+#include "power.h"
+#include "scene.h"
+#include "sync.h"
+#include "sysmon.h"
+#include "trace.h"
 #include "ui.h"
 
 #define TAG "main"
@@ -11,7 +22,37 @@
 void app_main(void)
 {
 	ESP_LOGI(TAG, "Welcome to tubalux!");
+#if CONFIG_LED_POWER_SAVE
+	power_init();
+#endif
+#if CONFIG_LED_TRACE
+	trace_init();
+#endif
+#if CONFIG_LED_FIXED_BENCHMARK
+	fixed_benchmark();
+#endif
 	led_init();
+#if CONFIG_LED_SCENE_RESTORE
+	scene_init();
+#endif
 	led_pattern_init();
+	palette_init();
+#if CONFIG_LED_SYNC_ESPNOW
+	sync_init(sync_transport_new_espnow(CONFIG_LED_WIFI_CHANNEL));
+#elif CONFIG_LED_SYNC_UDP
+	/* The socket needs the interface up, control_init() finds it already is */
+	net_init(CONFIG_LED_WIFI_CHANNEL);
+	sync_init(sync_transport_new_udp(CONFIG_LED_SYNC_UDP_GROUP, CONFIG_LED_SYNC_UDP_PORT));
+#endif
+#if CONFIG_LED_CONTROL
+	control_init();
+#endif
+#if CONFIG_LED_MIDI
+	midi_init();
+#endif
 	ui_init();
+#if CONFIG_LED_LATENCY
+	latency_init();
+#endif
+	sysmon_init();
 }
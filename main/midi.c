@@ -0,0 +1,187 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "leds.h"
+#include "led_patterns.h"
+#include "midi.h"
+#include "sysmon.h"
+
+#define TAG "midi"
+
+#if CONFIG_LED_MIDI
+#define MIDI_UART		CONFIG_LED_MIDI_UART
+#define MIDI_BAUD		31250
+#define MIDI_RX_BUF		256
+#define MIDI_TASK_STACK		2048
+#define MIDI_TRIGGER_LAYER	LED_NUM_ZONES	/* the first overlay */
+/* Clock ticks further apart than this mean the clock stopped */
+#define MIDI_CLOCK_TIMEOUT_US	500000
+/* Ignore tempo jitter under 1% */
+#define MIDI_TEMPO_HYSTERESIS	100
+
+typedef struct {
+	uint8_t cc;
+	led_control_param_t param;
+	int32_t min;
+	int32_t max;
+} midi_cc_map_t;
+
+static const midi_cc_map_t cc_map[] = {
+	{ 1, LED_CONTROL_HUE, 0, 359 },
+	{ 2, LED_CONTROL_HUE2, 0, 359 },
+	{ 3, LED_CONTROL_PERIOD, 2000000, 250000 },	/* 30 to 240 BPM */
+	{ 7, LED_CONTROL_INTENSITY, 0, 100 },
+};
+
+static TaskHandle_t midi_task;
+static int8_t held_note = -1;
+static int64_t clock_ticks[MIDI_PPQN];
+static uint8_t clock_idx = 0;
+static uint8_t clock_count = 0;
+
+static void midi_done(void* arg, int64_t latency)
+{
+	ESP_LOGD(TAG, "note to light %lld us", latency);
+}
+
+static void midi_control(led_control_param_t param, uint8_t layer, int32_t value, int64_t time, bool timed)
+{
+	led_control_t ctl = {
+		.param = param,
+		.layer = layer,
+		.value = value,
+		.time = time,
+		.done = timed ? midi_done : NULL,
+	};
+	if (!led_control(&ctl)) {
+		ESP_LOGW(TAG, "Dropped a change, the LED task is behind");
+	}
+}
+
+/* 24 clocks a beat, so the last 24 ticks span one period */
+static void midi_clock(int64_t time)
+{
+	if (clock_count && time - clock_ticks[(clock_idx + MIDI_PPQN - 1) % MIDI_PPQN] > MIDI_CLOCK_TIMEOUT_US) {
+		clock_count = 0;
+	}
+	if (clock_count == MIDI_PPQN) {
+		int32_t period = time - clock_ticks[clock_idx];
+		int32_t diff = period - (int32_t)led_get_period_us();
+		if (diff * MIDI_TEMPO_HYSTERESIS > period || -diff * MIDI_TEMPO_HYSTERESIS > period) {
+			midi_control(LED_CONTROL_PERIOD, 0, period, time, false);
+		}
+	} else {
+		clock_count++;
+	}
+	clock_ticks[clock_idx] = time;
+	clock_idx = (clock_idx + 1) % MIDI_PPQN;
+}
+
+static void midi_handle(const midi_msg_t* msg, int64_t time)
+{
+	switch (msg->status) {
+	case MIDI_CLOCK:
+		midi_clock(time);
+		return;
+	case MIDI_START:
+		clock_count = 0;
+		midi_control(LED_CONTROL_RESTART, 0, 0, time, false);
+		return;
+	case MIDI_STOP:
+		clock_count = 0;
+		return;
+	default:
+		break;
+	}
+	if (msg->status >= 0xf0) {
+		return;
+	}
+#if CONFIG_LED_MIDI_CHANNEL
+	if ((msg->status & 0x0f) != CONFIG_LED_MIDI_CHANNEL - 1) {
+		return;
+	}
+#endif
+	int note = msg->data[0] - CONFIG_LED_MIDI_BASE_NOTE;
+	switch (msg->status & 0xf0) {
+	case MIDI_NOTE_ON:
+		if (note >= 0 && note < LED_NUM_PATTERNS) {
+			held_note = note;
+			midi_control(LED_CONTROL_PATTERN, MIDI_TRIGGER_LAYER, note, time, true);
+		}
+		break;
+	case MIDI_NOTE_OFF:
+		if (note == held_note) {
+			held_note = -1;
+			midi_control(LED_CONTROL_PATTERN, MIDI_TRIGGER_LAYER, -1, time, false);
+		}
+		break;
+	case MIDI_PROGRAM:
+		for (uint8_t z = 0; msg->data[0] < LED_NUM_PATTERNS && z < LED_NUM_ZONES; z++) {
+			midi_control(LED_CONTROL_PATTERN, z, msg->data[0], time, false);
+		}
+		break;
+	case MIDI_CC:
+		for (int i = 0; i < sizeof(cc_map) / sizeof(cc_map[0]); i++) {
+			if (cc_map[i].cc == msg->data[0]) {
+				int32_t value = cc_map[i].min + (cc_map[i].max - cc_map[i].min) * msg->data[1] / 127;
+				midi_control(cc_map[i].param, 0, value, time, false);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void midi_loop(void* parameters)
+{
+	midi_parser_t parser = { 0 };
+	midi_msg_t msg;
+	uint8_t buf[32];
+	ESP_LOGI(TAG, "MIDI Thread Start");
+	while (true) {
+		/* Block for the first byte, then take whatever else has arrived */
+		int len = uart_read_bytes(MIDI_UART, buf, 1, portMAX_DELAY);
+		size_t more = 0;
+		if (len <= 0) {
+			continue;
+		}
+		int64_t time = esp_timer_get_time();
+		uart_get_buffered_data_len(MIDI_UART, &more);
+		if (more) {
+			more = (more < sizeof(buf) - 1) ? more : sizeof(buf) - 1;
+			len += uart_read_bytes(MIDI_UART, buf + 1, more, 0);
+		}
+		for (int i = 0; i < len; i++) {
+			if (midi_parse(&parser, buf[i], &msg)) {
+				midi_handle(&msg, time);
+			}
+		}
+	}
+}
+
+void midi_init()
+{
+	uart_config_t config = {
+		.baud_rate = MIDI_BAUD,
+		.data_bits = UART_DATA_8_BITS,
+		.parity = UART_PARITY_DISABLE,
+		.stop_bits = UART_STOP_BITS_1,
+		.flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+		.source_clk = UART_SCLK_APB,
+	};
+	ESP_ERROR_CHECK(uart_driver_install(MIDI_UART, MIDI_RX_BUF, 0, 0, NULL, 0));
+	ESP_ERROR_CHECK(uart_param_config(MIDI_UART, &config));
+	ESP_ERROR_CHECK(uart_set_pin(MIDI_UART, UART_PIN_NO_CHANGE, CONFIG_LED_MIDI_RX_GPIO,
+				     UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+	/* Interrupt on every byte, the default waits for a FIFO's worth or 10 idle bytes */
+	ESP_ERROR_CHECK(uart_set_rx_full_threshold(MIDI_UART, 1));
+	/* Above the LED task, so a note is queued before the frame it lands in */
+	SYSMON_TASK_CREATE(midi_loop, "MIDI", MIDI_TASK_STACK, NULL, 4, &midi_task, 0);
+}
+#endif /* CONFIG_LED_MIDI */
@@ -0,0 +1,13 @@
+#ifndef MIDI_H
+#define MIDI_H
+#include "midi_parse.h"
+
+/*
+ * Listen for MIDI on a UART. Notes from CONFIG_LED_MIDI_BASE_NOTE up trigger
+ * patterns on an overlay layer while held, program changes pick the base
+ * pattern, CC 1, 2 and 7 set the hues and intensity, CC 3 the tempo, and
+ * MIDI clock drives the tempo with start restarting the patterns.
+ */
+void midi_init(void);
+
+#endif /* MIDI_H */
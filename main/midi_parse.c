@@ -0,0 +1,59 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "midi_parse.h"
+
+static uint8_t midi_data_len(uint8_t status)
+{
+	switch (status & 0xf0) {
+	case MIDI_PROGRAM:
+	case 0xd0:
+		return 1;
+	case 0xf0:
+		if (status == 0xf1 || status == 0xf3) {
+			return 1;
+		}
+		return (status == 0xf2) ? 2 : 0;
+	default:
+		return 2;
+	}
+}
+
+bool midi_parse(midi_parser_t* parser, uint8_t byte, midi_msg_t* msg)
+{
+	/* Real-time messages can come between any two bytes and don't touch running status */
+	if (byte >= MIDI_CLOCK) {
+		msg->status = byte;
+		return true;
+	}
+	if (byte & 0x80) {
+		parser->count = 0;
+		/* Sysex data is skipped until the next status byte */
+		parser->status = (byte == 0xf0 || byte == 0xf7) ? 0 : byte;
+		if (!parser->status || midi_data_len(byte)) {
+			return false;
+		}
+		/* Tune request and friends have no data and cancel running status */
+		parser->status = 0;
+		msg->status = byte;
+		return true;
+	}
+	if (!parser->status) {
+		return false;
+	}
+	parser->data[parser->count++] = byte;
+	if (parser->count < midi_data_len(parser->status)) {
+		return false;
+	}
+	parser->count = 0;
+	msg->status = parser->status;
+	msg->data[0] = parser->data[0];
+	msg->data[1] = parser->data[1];
+	if (parser->status >= 0xf0) {
+		parser->status = 0;
+	}
+	if ((msg->status & 0xf0) == MIDI_NOTE_ON && !msg->data[1]) {
+		msg->status = MIDI_NOTE_OFF | (msg->status & 0x0f);
+	}
+	return true;
+}
@@ -0,0 +1,36 @@
+#ifndef MIDI_PARSE_H
+#define MIDI_PARSE_H
+#include <stdbool.h>
+#include <stdint.h>
+
+/* MIDI 1.0 messages out of the bytes on the wire */
+#define MIDI_NOTE_OFF		0x80
+#define MIDI_NOTE_ON		0x90
+#define MIDI_CC			0xb0
+#define MIDI_PROGRAM		0xc0
+#define MIDI_CLOCK		0xf8
+#define MIDI_START		0xfa
+#define MIDI_CONTINUE		0xfb
+#define MIDI_STOP		0xfc
+
+#define MIDI_PPQN		24	/* clocks per beat */
+
+typedef struct {
+	uint8_t status;		/* running status, 0 when data bytes are to be dropped */
+	uint8_t data[2];
+	uint8_t count;
+} midi_parser_t;
+
+typedef struct {
+	uint8_t status;		/* channel messages keep their channel in the low nibble */
+	uint8_t data[2];
+} midi_msg_t;
+
+/*
+ * Feed one byte from the wire, returns true when it completes a message.
+ * Handles running status, real-time bytes in the middle of messages and
+ * skips sysex. A note on with velocity 0 comes out as a note off.
+ */
+bool midi_parse(midi_parser_t* parser, uint8_t byte, midi_msg_t* msg);
+
+#endif /* MIDI_PARSE_H */
@@ -0,0 +1,63 @@
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+
+#include "net.h"
+
+#define TAG "net"
+
+#if CONFIG_LED_CONTROL
+#define NET_MAX_CLIENTS	4
+#endif
+
+static bool up = false;
+static wifi_interface_t iface;
+
+wifi_interface_t net_init(uint8_t channel)
+{
+	if (up) {
+		return iface;
+	}
+	esp_err_t err = nvs_flash_init();
+	if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+		ESP_ERROR_CHECK(nvs_flash_erase());
+		err = nvs_flash_init();
+	}
+	ESP_ERROR_CHECK(err);
+	ESP_ERROR_CHECK(esp_netif_init());
+	ESP_ERROR_CHECK(esp_event_loop_create_default());
+	wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+	ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+	ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+#if CONFIG_LED_CONTROL
+	esp_netif_create_default_wifi_ap();
+	wifi_config_t ap = {
+		.ap = {
+			.ssid = CONFIG_LED_CONTROL_SSID,
+			.ssid_len = strlen(CONFIG_LED_CONTROL_SSID),
+			.password = CONFIG_LED_CONTROL_PASSWORD,
+			.channel = channel,
+			.max_connection = NET_MAX_CLIENTS,
+			.authmode = strlen(CONFIG_LED_CONTROL_PASSWORD) ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN,
+		},
+	};
+	ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap));
+	iface = WIFI_IF_AP;
+#else
+	ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+	iface = WIFI_IF_STA;
+#endif
+	ESP_ERROR_CHECK(esp_wifi_start());
+	ESP_ERROR_CHECK(esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE));
+	/* Power save adds tens of ms of jitter to every packet */
+	ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
+	ESP_LOGI(TAG, "Wi-Fi up on channel %u", channel);
+	up = true;
+	return iface;
+}
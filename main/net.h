@@ -0,0 +1,12 @@
+#ifndef NET_H
+#define NET_H
+#include "esp_wifi.h"
+
+/*
+ * Bring up Wi-Fi for everything that needs it, once. With CONFIG_LED_CONTROL
+ * the unit is an access point for phones to join, otherwise a station that
+ * never connects. Returns the interface the radio is on.
+ */
+wifi_interface_t net_init(uint8_t channel);
+
+#endif /* NET_H */
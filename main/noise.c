@@ -0,0 +1,101 @@
+#include <stdint.h>
+
+#include "fixed.h"
+#include "noise.h"
+
+#define NOISE_MAX_OCTAVES	8
+
+/* Cheap integer hash of a lattice point, only the top byte is used */
+static inline uint8_t noise_hash(uint32_t x, uint32_t y, uint32_t z)
+{
+	uint32_t h = x * 0x8da6b343 + y * 0xd8163841 + z * 0xcb1ab31f;
+	h ^= h >> 13;
+	h *= 0x5bd1e995;
+	h ^= h >> 15;
+	return h >> 24;
+}
+
+static inline int32_t noise_lerp(int32_t a, int32_t b, uint32_t t)
+{
+	return a + (((b - a) * (int32_t)t) >> 8);
+}
+
+/*
+ * 2^20 over the summed octave amplitudes, 256 - (256 >> octaves), rounded
+ * up so normalising is a multiply. At most one more than dividing.
+ */
+static const uint16_t octave_scale[NOISE_MAX_OCTAVES + 1] = {
+	0, 8192, 5462, 4682, 4370, 4229, 4162, 4129, 4113,
+};
+
+uint8_t noise8_1d(uint32_t x)
+{
+	uint32_t xi = x >> 8;
+	uint32_t u = ease8_in_out_cubic(x & 0xff);
+	return noise_lerp(noise_hash(xi, 0, 0), noise_hash(xi + 1, 0, 0), u);
+}
+
+uint8_t noise8_2d(uint32_t x, uint32_t y)
+{
+	uint32_t xi = x >> 8, yi = y >> 8;
+	uint32_t u = ease8_in_out_cubic(x & 0xff), v = ease8_in_out_cubic(y & 0xff);
+	int32_t a = noise_lerp(noise_hash(xi, yi, 0), noise_hash(xi + 1, yi, 0), u);
+	int32_t b = noise_lerp(noise_hash(xi, yi + 1, 0), noise_hash(xi + 1, yi + 1, 0), u);
+	return noise_lerp(a, b, v);
+}
+
+uint8_t noise8_3d(uint32_t x, uint32_t y, uint32_t z)
+{
+	uint32_t xi = x >> 8, yi = y >> 8, zi = z >> 8;
+	uint32_t u = ease8_in_out_cubic(x & 0xff), v = ease8_in_out_cubic(y & 0xff), w = ease8_in_out_cubic(z & 0xff);
+	int32_t a = noise_lerp(noise_hash(xi, yi, zi), noise_hash(xi + 1, yi, zi), u);
+	int32_t b = noise_lerp(noise_hash(xi, yi + 1, zi), noise_hash(xi + 1, yi + 1, zi), u);
+	int32_t c = noise_lerp(noise_hash(xi, yi, zi + 1), noise_hash(xi + 1, yi, zi + 1), u);
+	int32_t d = noise_lerp(noise_hash(xi, yi + 1, zi + 1), noise_hash(xi + 1, yi + 1, zi + 1), u);
+	return noise_lerp(noise_lerp(a, b, v), noise_lerp(c, d, v), w);
+}
+
+uint8_t noise8_octaves_1d(uint32_t x, uint8_t octaves)
+{
+	uint32_t sum = 0, amp = 128;
+	if (octaves > NOISE_MAX_OCTAVES) {
+		octaves = NOISE_MAX_OCTAVES;
+	}
+	for (uint8_t i = 0; i < octaves; i++) {
+		sum += noise8_1d(x) * amp;
+		x <<= 1;
+		amp >>= 1;
+	}
+	return (sum * octave_scale[octaves]) >> 20;
+}
+
+uint8_t noise8_octaves_2d(uint32_t x, uint32_t y, uint8_t octaves)
+{
+	uint32_t sum = 0, amp = 128;
+	if (octaves > NOISE_MAX_OCTAVES) {
+		octaves = NOISE_MAX_OCTAVES;
+	}
+	for (uint8_t i = 0; i < octaves; i++) {
+		sum += noise8_2d(x, y) * amp;
+		x <<= 1;
+		y <<= 1;
+		amp >>= 1;
+	}
+	return (sum * octave_scale[octaves]) >> 20;
+}
+
+uint8_t noise8_octaves_3d(uint32_t x, uint32_t y, uint32_t z, uint8_t octaves)
+{
+	uint32_t sum = 0, amp = 128;
+	if (octaves > NOISE_MAX_OCTAVES) {
+		octaves = NOISE_MAX_OCTAVES;
+	}
+	for (uint8_t i = 0; i < octaves; i++) {
+		sum += noise8_3d(x, y, z) * amp;
+		x <<= 1;
+		y <<= 1;
+		z <<= 1;
+		amp >>= 1;
+	}
+	return (sum * octave_scale[octaves]) >> 20;
+}
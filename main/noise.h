@@ -0,0 +1,18 @@
+#ifndef NOISE_H
+#define NOISE_H
+#include <stdint.h>
+
+/*
+ * Integer value noise. Coordinates are 24.8 fixed point, so one lattice cell
+ * is 256 units wide, and results are 0-255. Octave variants add up to 8
+ * layers at double the frequency and half the amplitude of the previous one.
+ */
+uint8_t noise8_1d(uint32_t x);
+uint8_t noise8_2d(uint32_t x, uint32_t y);
+uint8_t noise8_3d(uint32_t x, uint32_t y, uint32_t z);
+
+uint8_t noise8_octaves_1d(uint32_t x, uint8_t octaves);
+uint8_t noise8_octaves_2d(uint32_t x, uint32_t y, uint8_t octaves);
+uint8_t noise8_octaves_3d(uint32_t x, uint32_t y, uint32_t z, uint8_t octaves);
+
+#endif /* NOISE_H */
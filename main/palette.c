@@ -0,0 +1,132 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fixed.h"
+#include "leds.h"
+#include "palette.h"
+
+static const palette_stop_t rainbow_stops[] = {
+	{ 0, 255, 0, 0 },
+	{ 42, 255, 255, 0 },
+	{ 85, 0, 255, 0 },
+	{ 128, 0, 255, 255 },
+	{ 170, 0, 0, 255 },
+	{ 212, 255, 0, 255 },
+	{ 255, 255, 0, 0 },
+};
+
+static const palette_stop_t fire_stops[] = {
+	{ 0, 0, 0, 0 },
+	{ 64, 128, 0, 0 },
+	{ 128, 255, 64, 0 },
+	{ 192, 255, 192, 0 },
+	{ 255, 255, 255, 160 },
+};
+
+static const palette_stop_t ocean_stops[] = {
+	{ 0, 0, 0, 32 },
+	{ 96, 0, 64, 128 },
+	{ 160, 0, 160, 160 },
+	{ 224, 96, 224, 255 },
+	{ 255, 0, 0, 32 },
+};
+
+static const palette_stop_t lava_stops[] = {
+	{ 0, 0, 0, 0 },
+	{ 80, 96, 0, 0 },
+	{ 150, 255, 32, 0 },
+	{ 200, 255, 128, 0 },
+	{ 255, 0, 0, 0 },
+};
+
+static const palette_stop_t forest_stops[] = {
+	{ 0, 0, 32, 0 },
+	{ 100, 16, 128, 16 },
+	{ 170, 96, 160, 32 },
+	{ 255, 0, 32, 0 },
+};
+
+#define GRADIENT(n, s) { .name = n, .stops = s, .num_stops = sizeof(s) / sizeof(s[0]) }
+
+static const palette_gradient_t gradients[PALETTE_NUM_GRADIENTS] = {
+	{ .name = "Hues", .stops = NULL },
+	GRADIENT("Rainbow", rainbow_stops),
+	GRADIENT("Fire", fire_stops),
+	GRADIENT("Ocean", ocean_stops),
+	GRADIENT("Lava", lava_stops),
+	GRADIENT("Forest", forest_stops),
+};
+
+ui_menu_t palette_menu[PALETTE_NUM_GRADIENTS];
+
+static inline uint8_t palette_lerp8(uint8_t a, uint8_t b, uint32_t t, uint32_t len)
+{
+	return a + ((int32_t)(b - a) * (int32_t)t) / (int32_t)len;
+}
+
+/* Expand RGB stops into the table, scaled to intensity (0-100) */
+void palette_fill_gradient(palette_t* pal, const palette_stop_t* stops, uint8_t num_stops, uint8_t intensity)
+{
+	uint8_t scale = percent8(intensity);
+	for (uint8_t s = 0; s + 1 < num_stops; s++) {
+		const palette_stop_t* a = &stops[s];
+		const palette_stop_t* b = &stops[s + 1];
+		uint32_t len = (b->pos > a->pos) ? b->pos - a->pos : 1;
+		for (uint32_t i = a->pos; i <= b->pos; i++) {
+			uint32_t t = i - a->pos;
+			led_rgb_t* e = &pal->entry[i];
+			e->r = scale8(palette_lerp8(a->r, b->r, t, len), scale);
+			e->g = scale8(palette_lerp8(a->g, b->g, t, len), scale);
+			e->b = scale8(palette_lerp8(a->b, b->b, t, len), scale);
+		}
+	}
+}
+
+/* Fill entries start to end (inclusive) going from h1/v1 to h2/v2, hues may run backwards or past 360 */
+void palette_fill_hsv(palette_t* pal, uint8_t start, uint8_t end, int32_t h1, int32_t h2, uint8_t v1, uint8_t v2)
+{
+	int32_t len = end - start;
+	for (int32_t i = 0; i <= len; i++) {
+		int32_t h = len ? h1 + ((h2 - h1) * i) / len : h1;
+		int32_t v = len ? v1 + ((v2 - v1) * i) / len : v1;
+		led_rgb_t* e = &pal->entry[start + i];
+		led_strip_hsv2rgb((h % 360 + 360) % 360, 100, v, &e->r, &e->g, &e->b);
+	}
+}
+
+/* Move every entry amount/256 of the way towards target, returns false once they match */
+bool palette_blend(palette_t* pal, const palette_t* target, uint8_t amount)
+{
+	bool changed = false;
+	uint8_t* cur = (uint8_t*)pal->entry;
+	const uint8_t* dst = (const uint8_t*)target->entry;
+	for (uint32_t i = 0; i < sizeof(pal->entry); i++) {
+		if (cur[i] != dst[i]) {
+			int32_t step = ((int32_t)(dst[i] - cur[i]) * amount) >> 8;
+			if (!step) {
+				step = (dst[i] > cur[i]) ? 1 : -1;
+			}
+			cur[i] += step;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+const palette_gradient_t* get_gradients()
+{
+	return gradients;
+}
+
+ui_menu_t* get_palette_menu()
+{
+	return palette_menu;
+}
+
+void palette_init()
+{
+	for (int i = 0; i < PALETTE_NUM_GRADIENTS; i++) {
+		strcpy(palette_menu[i].name, gradients[i].name);
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "led_frame.h"
+#include "ui.h"
+
+/*
+ * Palettes are expanded into 256-entry RGB tables once, whenever the
+ * gradient or a parameter changes, so patterns get a colour with one lookup.
+ */
+typedef struct {
+	uint8_t pos;	/* 0-255, first stop must be 0 and last 255 */
+	uint8_t r, g, b;
+} palette_stop_t;
+
+typedef struct {
+	/* this must be first! */
+	char name[17];
+	/* NULL stops means the gradient is built from the primary and secondary hue */
+	const palette_stop_t* stops;
+	uint8_t num_stops;
+} palette_gradient_t;
+
+typedef struct {
+	led_rgb_t entry[256];
+} palette_t;
+
+#define PALETTE_NUM_GRADIENTS	6
+
+static inline const led_rgb_t* palette_get(const palette_t* pal, uint8_t index)
+{
+	return &pal->entry[index];
+}
+
+void palette_fill_gradient(palette_t* pal, const palette_stop_t* stops, uint8_t num_stops, uint8_t intensity);
+void palette_fill_hsv(palette_t* pal, uint8_t start, uint8_t end, int32_t h1, int32_t h2, uint8_t v1, uint8_t v2);
+bool palette_blend(palette_t* pal, const palette_t* target, uint8_t amount);
+
+const palette_gradient_t* get_gradients(void);
+ui_menu_t* get_palette_menu(void);
+void palette_init(void);
+
+#endif /* PALETTE_H */
@@ -0,0 +1,147 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fixed.h"
+#include "particles.h"
+
+/*
+ * 2^16 over tail + 1, rounded up so fading a tail out is a multiply. Exact
+ * for any 8 bit brightness. Nothing reads the entry for no tail.
+ */
+#define TAIL_RECIP(t)		(uint16_t)((65536 + (t)) / ((t) + 1))
+#define TAIL_RECIP4(t)		TAIL_RECIP(t), TAIL_RECIP(t + 1), TAIL_RECIP(t + 2), TAIL_RECIP(t + 3)
+#define TAIL_RECIP16(t)		TAIL_RECIP4(t), TAIL_RECIP4(t + 4), TAIL_RECIP4(t + 8), TAIL_RECIP4(t + 12)
+#define TAIL_RECIP64(t)		TAIL_RECIP16(t), TAIL_RECIP16(t + 16), TAIL_RECIP16(t + 32), TAIL_RECIP16(t + 48)
+
+static const uint16_t tail_recip[256] = {
+	TAIL_RECIP64(0), TAIL_RECIP64(64), TAIL_RECIP64(128), TAIL_RECIP64(192),
+};
+
+void particles_init(particles_t* p, void* storage, uint16_t capacity)
+{
+	uint8_t* s = storage;
+	/* Widest fields first, so they all stay aligned */
+	p->pos = (int32_t*)s;
+	s += capacity * sizeof(int32_t);
+	p->vel = (int32_t*)s;
+	s += capacity * sizeof(int32_t);
+	p->life = (uint16_t*)s;
+	s += capacity * sizeof(uint16_t);
+	p->bright = s;
+	s += capacity;
+	p->fade = s;
+	s += capacity;
+	p->tail = s;
+	s += capacity;
+	p->color = (led_rgb_t*)s;
+	p->num = 0;
+	p->capacity = capacity;
+}
+
+int32_t particles_emit(particles_t* p, const particles_emitter_t* e, rng_t* rng)
+{
+	if (p->num >= p->capacity) {
+		return -1;
+	}
+	uint16_t i = p->num++;
+	p->pos[i] = e->pos;
+	p->vel[i] = e->vel;
+	if (e->spread) {
+		p->vel[i] += (int32_t)rng_below(rng, 2 * e->spread + 1) - e->spread;
+	}
+	p->life[i] = e->life;
+	p->bright[i] = e->bright;
+	p->fade[i] = e->fade;
+	p->tail[i] = e->tail;
+	p->color[i] = e->color;
+	return i;
+}
+
+/* The last particle takes the place of the dead one */
+static inline void particles_kill(particles_t* p, uint32_t i)
+{
+	uint32_t last = --p->num;
+	p->pos[i] = p->pos[last];
+	p->vel[i] = p->vel[last];
+	p->life[i] = p->life[last];
+	p->bright[i] = p->bright[last];
+	p->fade[i] = p->fade[last];
+	p->tail[i] = p->tail[last];
+	p->color[i] = p->color[last];
+}
+
+void particles_step(particles_t* p, uint32_t len)
+{
+	int32_t end = PARTICLES_FIXED(len - 1);
+	for (uint32_t i = 0; i < p->num;) {
+		/* Fine for anything slower than the whole of a long strip per step */
+		int32_t v = p->vel[i] + p->gravity;
+		v -= v * p->drag / 256;
+		int32_t x = p->pos[i] + v;
+		bool gone = false;
+		if (p->edge == PARTICLES_EDGE_BOUNCE) {
+			if (x < 0) {
+				x = -x;
+				v = -v;
+			} else if (x > end) {
+				x = 2 * end - x;
+				v = -v;
+			}
+			/* Only a step longer than the strip gets this far */
+			x = (x < 0) ? 0 : (x > end) ? end : x;
+		} else {
+			/* Gone once its tail has left too */
+			int32_t margin = PARTICLES_FIXED(p->tail[i] + 1);
+			gone = x < -margin || x > end + margin;
+		}
+		uint8_t bright = qsub8(p->bright[i], p->fade[i]);
+		if (gone || !bright || (p->life[i] && !--p->life[i])) {
+			particles_kill(p, i);
+			continue;
+		}
+		p->pos[i] = x;
+		p->vel[i] = v;
+		p->bright[i] = bright;
+		i++;
+	}
+}
+
+static inline void particles_add(led_frame_t* frame, int32_t i, led_rgb_t c, uint8_t v)
+{
+	if ((uint32_t)i < frame->num) {
+		led_rgb_t* px = &frame->pixels[i];
+		px->r = qadd8(px->r, scale8(c.r, v));
+		px->g = qadd8(px->g, scale8(c.g, v));
+		px->b = qadd8(px->b, scale8(c.b, v));
+	}
+}
+
+/* A point at x lights the pixels either side in proportion to how close it is */
+static inline void particles_point(led_frame_t* frame, int32_t x, led_rgb_t c, uint8_t v)
+{
+	uint8_t frac = x >> 8;
+	particles_add(frame, x >> 16, c, scale8(v, 255 - frac));
+	particles_add(frame, (x >> 16) + 1, c, scale8(v, frac));
+}
+
+void particles_render(const particles_t* p, led_frame_t* frame)
+{
+	for (uint32_t i = 0; i < p->num; i++) {
+		int32_t x = p->pos[i];
+		uint32_t v = p->bright[i];
+		led_rgb_t c = p->color[i];
+		particles_point(frame, x, c, v);
+		uint32_t tail = p->tail[i];
+		if (!tail) {
+			continue;
+		}
+		/* Behind is away from where it's heading, fading out a step per pixel */
+		int32_t step = (p->vel[i] < 0) ? PARTICLES_FIXED(1) : -PARTICLES_FIXED(1);
+		uint32_t dv = (v * tail_recip[tail]) >> 16;
+		for (uint32_t k = 0; k < tail; k++) {
+			x += step;
+			v -= dv;
+			particles_point(frame, x, c, v);
+		}
+	}
+}
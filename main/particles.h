@@ -0,0 +1,62 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "led_frame.h"
+#include "rng.h"
+
+/*
+ * A fixed pool of particles moving along the strip, for patterns whose
+ * motion is made of things rather than of pixels. Positions are pixels in
+ * 16.16 fixed point and velocities pixels per step, so patterns step once
+ * per frame and set speeds from the tempo. Each field is an array of its
+ * own, so the update and the render only touch the fields they use. Live
+ * particles are packed at the front and nothing is allocated after init.
+ */
+typedef enum {
+	PARTICLES_EDGE_DIE,	/* particles leaving the strip are gone */
+	PARTICLES_EDGE_BOUNCE,	/* the ends turn particles around */
+} particles_edge_t;
+
+typedef struct {
+	int32_t* pos;
+	int32_t* vel;
+	uint16_t* life;		/* steps left, 0 lives until it fades or leaves */
+	uint8_t* bright;
+	uint8_t* fade;		/* taken off bright every step */
+	uint8_t* tail;		/* pixels of tail trailing behind */
+	led_rgb_t* color;
+	uint16_t num;
+	uint16_t capacity;
+	int32_t gravity;	/* added to every velocity each step */
+	uint8_t drag;		/* velocities lose drag / 256 each step */
+	particles_edge_t edge;
+} particles_t;
+
+/* What an emitter gives each new particle */
+typedef struct {
+	int32_t pos;
+	int32_t vel;
+	int32_t spread;		/* the velocity varies by up to this either way */
+	uint16_t life;
+	uint8_t bright;
+	uint8_t fade;
+	uint8_t tail;
+	led_rgb_t color;
+} particles_emitter_t;
+
+#define PARTICLES_FIXED(pixels)	((int32_t)(pixels) * 65536)
+/* Word aligned storage for a pool of n particles */
+#define PARTICLES_STORAGE_SIZE(n) \
+	((n) * (2 * sizeof(int32_t) + sizeof(uint16_t) + 3 * sizeof(uint8_t) + sizeof(led_rgb_t)))
+
+void particles_init(particles_t* p, void* storage, uint16_t capacity);
+/* Returns the index of the new particle, or -1 if the pool is full */
+int32_t particles_emit(particles_t* p, const particles_emitter_t* e, rng_t* rng);
+/* Move, age and retire every particle, on a strip of len pixels */
+void particles_step(particles_t* p, uint32_t len);
+/* Add every particle onto the frame, split between the two pixels it is between */
+void particles_render(const particles_t* p, led_frame_t* frame);
+
+#endif /* PARTICLES_H */
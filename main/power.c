@@ -0,0 +1,108 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+
+#include "power.h"
+
+#if CONFIG_LED_POWER_SAVE
+#define TAG "power"
+
+#define POWER_REPORT_MS		1000
+
+static esp_pm_lock_handle_t render_lock;
+/* Whether frames render at the full clock, only the LED task touches it */
+static bool render_fast = false;
+#if CONFIG_LED_POWER_REPORT
+static uint32_t wakeups_fast = 0;
+static uint32_t wakeups = 0;
+#endif
+
+void power_render_begin()
+{
+	if (render_fast) {
+		esp_pm_lock_acquire(render_lock);
+	}
+}
+
+/*
+ * busy is how long the frame took and budget how long it had until the next
+ * one is due, both in us. Going fast costs more than it saves while the slow
+ * clock leaves plenty of time to sleep, so only frames that took over half
+ * their budget switch it on, and it stays on until they take under an eighth.
+ */
+void power_render_end(int64_t busy, int64_t budget)
+{
+	if (render_fast) {
+		esp_pm_lock_release(render_lock);
+	}
+#if CONFIG_LED_POWER_REPORT
+	wakeups++;
+	wakeups_fast += render_fast;
+#endif
+	if (!render_fast && busy * 2 > budget) {
+		render_fast = true;
+	} else if (render_fast && busy * 8 < budget) {
+		render_fast = false;
+	}
+}
+
+#if CONFIG_LED_POWER_REPORT
+/* Time the idle tasks got is time the cores spent idle or asleep */
+static void power_report(TimerHandle_t timer)
+{
+	static uint32_t last_idle[portNUM_PROCESSORS];
+	static uint32_t last_total;
+	uint32_t total = portGET_RUN_TIME_COUNTER_VALUE();
+	uint32_t elapsed = total - last_total;
+	last_total = total;
+	for (uint8_t c = 0; c < portNUM_PROCESSORS; c++) {
+		TaskStatus_t status;
+		vTaskGetInfo(xTaskGetIdleTaskHandleForCPU(c), &status, pdFALSE, eInvalid);
+		uint32_t idle = status.ulRunTimeCounter - last_idle[c];
+		last_idle[c] = status.ulRunTimeCounter;
+		if (elapsed) {
+			uint32_t idle_us = (uint64_t)idle * POWER_REPORT_MS * 1000 / elapsed;
+			ESP_LOGI(TAG, "core %u active %u us idle %u us per second", c,
+				 POWER_REPORT_MS * 1000 - idle_us, idle_us);
+		}
+	}
+	ESP_LOGI(TAG, "LED task at full clock for %u of %u wakeups", wakeups_fast, wakeups);
+	wakeups_fast = 0;
+	wakeups = 0;
+}
+#endif
+
+void power_init()
+{
+	esp_pm_config_esp32_t pm_config = {
+		.max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+		.min_freq_mhz = CONFIG_LED_POWER_MIN_MHZ,
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+		.light_sleep_enable = true,
+#endif
+	};
+	ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+	ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "render", &render_lock));
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+	/* The buttons wake it, the LED frame timer and the strip's own lock see to the rest */
+	ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+#endif
+#if CONFIG_LED_POWER_REPORT
+	TickType_t period = pdMS_TO_TICKS(POWER_REPORT_MS);
+	TimerHandle_t timer;
+#if CONFIG_LED_STATIC_ALLOC
+	static StaticTimer_t timer_buf;
+	timer = xTimerCreateStatic("power", period, pdTRUE, NULL, power_report, &timer_buf);
+#else
+	timer = xTimerCreate("power", period, pdTRUE, NULL, power_report);
+#endif
+	xTimerStart(timer, 0);
+#endif
+	ESP_LOGI(TAG, "CPU at %u to %u MHz", CONFIG_LED_POWER_MIN_MHZ, CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+}
+#endif
@@ -0,0 +1,15 @@
+#ifndef POWER_H
+#define POWER_H
+#include <stdint.h>
+
+/*
+ * Power management for running off a battery. The CPU idles at a low clock
+ * and sleeps lightly between frames, and the LED task brackets its work with
+ * power_render_begin() and power_render_end() so patterns that need the CPU
+ * get the full clock while they render.
+ */
+void power_render_begin(void);
+void power_render_end(int64_t busy, int64_t budget);
+void power_init(void);
+
+#endif /* POWER_H */
@@ -0,0 +1,40 @@
+#include <stdint.h>
+#include <string.h>
+#include "esp_system.h"
+
+#include "rng.h"
+
+static uint32_t default_seed = CONFIG_LED_RNG_SEED;
+
+/* Seed for rng_seed(rng, 0) from now on, 0 for the hardware RNG */
+void rng_set_default_seed(uint32_t seed)
+{
+	default_seed = seed;
+}
+
+/* A seed of 0 uses the default seed, or the hardware RNG if that is 0 too */
+void rng_seed(rng_t* rng, uint32_t seed)
+{
+	if (!seed) {
+		seed = default_seed;
+	}
+	while (!seed) {
+		seed = esp_random();
+	}
+	rng->state = seed;
+}
+
+void rng_fill(rng_t* rng, void* buf, size_t len)
+{
+	uint8_t* dst = buf;
+	while (len >= sizeof(uint32_t)) {
+		uint32_t r = rng_next(rng);
+		memcpy(dst, &r, sizeof(r));
+		dst += sizeof(r);
+		len -= sizeof(r);
+	}
+	if (len) {
+		uint32_t r = rng_next(rng);
+		memcpy(dst, &r, len);
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef RNG_H
+#define RNG_H
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per-pattern xorshift32 PRNG. Much cheaper than a hardware RNG read, and
+ * reproducible when seeded with a fixed value (see CONFIG_LED_RNG_SEED).
+ */
+typedef struct {
+	uint32_t state;
+} rng_t;
+
+void rng_set_default_seed(uint32_t seed);
+void rng_seed(rng_t* rng, uint32_t seed);
+void rng_fill(rng_t* rng, void* buf, size_t len);
+
+static inline uint32_t rng_next(rng_t* rng)
+{
+	uint32_t x = rng->state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	rng->state = x;
+	return x;
+}
+
+/* Unbiased value in [0, n), Lemire's multiply-shift with rejection */
+static inline uint32_t rng_below(rng_t* rng, uint32_t n)
+{
+	uint64_t m = (uint64_t)rng_next(rng) * n;
+	uint32_t low = (uint32_t)m;
+	if (low < n) {
+		uint32_t threshold = -n % n;
+		while (low < threshold) {
+			m = (uint64_t)rng_next(rng) * n;
+			low = (uint32_t)m;
+		}
+	}
+	return m >> 32;
+}
+
+/* Value in [min, max], inclusive */
+static inline uint32_t rng_range(rng_t* rng, uint32_t min, uint32_t max)
+{
+	return rng_below(rng, max - min + 1) + min;
+}
+
+#endif /* RNG_H */
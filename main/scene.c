@@ -0,0 +1,180 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "leds.h"
+#include "led_patterns.h"
+#include "scene.h"
+#include "sysmon.h"
+
+#if CONFIG_LED_SCENE_RESTORE
+#define TAG "scene"
+
+#define SCENE_TASK_STACK	2560
+#define SCENE_POLL_MS		250
+/* Flash only gets the scene once it has stayed put this long */
+#define SCENE_SAVE_MS		5000
+#define SCENE_NVS_NAMESPACE	"tubalux"
+#define SCENE_NVS_KEY		"scene"
+
+typedef struct {
+	scene_t scene;
+	uint32_t crc;
+} scene_rtc_t;
+
+static RTC_NOINIT_ATTR scene_rtc_t rtc;
+static TaskHandle_t scene_task;
+
+static uint32_t scene_crc(const scene_t* scene)
+{
+	return esp_rom_crc32_le(0, (const uint8_t*)scene, sizeof(*scene));
+}
+
+/* Zeroed first so the padding compares and checksums the same every time */
+static void scene_capture(scene_t* scene)
+{
+	memset(scene, 0, sizeof(*scene));
+	scene->version = SCENE_VERSION;
+	scene->hue = led_get_primary_hue();
+	scene->hue2 = led_get_secondary_hue();
+	scene->period_us = led_get_period_us();
+	scene->intensity = led_get_intensity();
+	scene->palette = led_get_palette_index();
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		led_layer_params_t params;
+		led_get_layer_params(l, &params);
+		if (params.pattern) {
+			strcpy(scene->pattern[l], params.pattern->name);
+		}
+		scene->blend[l] = params.blend;
+		scene->opacity[l] = params.opacity;
+	}
+}
+
+/* NULL for none, or one this build doesn't have */
+static led_pattern_t* scene_find_pattern(const char* name)
+{
+	for (uint32_t i = 0; name[0] && i < LED_NUM_PATTERNS; i++) {
+		if (!strncmp(get_patterns()[i].name, name, LED_PATTERN_NAME_LEN)) {
+			return &get_patterns()[i];
+		}
+	}
+	return NULL;
+}
+
+static void scene_apply(const scene_t* scene)
+{
+	led_set_primary_hue(scene->hue);
+	led_set_secondary_hue(scene->hue2);
+	led_set_period_us(scene->period_us);
+	led_set_intensity(scene->intensity);
+	led_set_palette(scene->palette);
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		led_layer_params_t params = {
+			.pattern = scene_find_pattern(scene->pattern[l]),
+			.blend = scene->blend[l],
+			.opacity = scene->opacity[l],
+			.start = led_get_time(),
+		};
+		led_set_layer_params(l, &params);
+	}
+}
+
+static esp_err_t scene_nvs_init(void)
+{
+	esp_err_t err = nvs_flash_init();
+	if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+		ESP_ERROR_CHECK(nvs_flash_erase());
+		err = nvs_flash_init();
+	}
+	return err;
+}
+
+static bool scene_load(scene_t* scene)
+{
+	nvs_handle_t nvs;
+	size_t size = sizeof(*scene);
+	if (scene_nvs_init() != ESP_OK || nvs_open(SCENE_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+		return false;
+	}
+	/* A scene saved by a build with a different layout doesn't fit or has another version, and is ignored */
+	esp_err_t err = nvs_get_blob(nvs, SCENE_NVS_KEY, scene, &size);
+	nvs_close(nvs);
+	return err == ESP_OK && size == sizeof(*scene) && scene->version == SCENE_VERSION;
+}
+
+static void scene_save(const scene_t* scene)
+{
+	nvs_handle_t nvs;
+	esp_err_t err = nvs_open(SCENE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+	if (err == ESP_OK) {
+		err = nvs_set_blob(nvs, SCENE_NVS_KEY, scene, sizeof(*scene));
+		if (err == ESP_OK) {
+			err = nvs_commit(nvs);
+		}
+		nvs_close(nvs);
+	}
+	if (err != ESP_OK) {
+		ESP_LOGW(TAG, "Saving scene failed: %s", esp_err_to_name(err));
+	}
+}
+
+/*
+ * Called by led_init before the LED task starts, so the first frame is
+ * already the restored scene. Returns false if there was none to restore.
+ */
+bool scene_restore()
+{
+	scene_t scene;
+	/* RTC memory also survives an update, which may have changed the layout */
+	if (rtc.crc == scene_crc(&rtc.scene) && rtc.scene.version == SCENE_VERSION) {
+		ESP_LOGI(TAG, "Restoring scene from RTC memory, reset reason %d", esp_reset_reason());
+		scene_apply(&rtc.scene);
+		return true;
+	}
+	if (scene_load(&scene)) {
+		ESP_LOGI(TAG, "Restoring scene from flash");
+		rtc.scene = scene;
+		rtc.crc = scene_crc(&scene);
+		scene_apply(&scene);
+		return true;
+	}
+	return false;
+}
+
+/* Copies the scene to RTC memory as soon as it changes and to flash once it settles */
+static void scene_loop(void* parameters)
+{
+	scene_t scene;
+	uint32_t settled = 0;
+	/* Flash may be behind a scene restored from RTC memory, NVS skips writing one it already has */
+	bool saved = false;
+	while (true) {
+		vTaskDelay(pdMS_TO_TICKS(SCENE_POLL_MS));
+		scene_capture(&scene);
+		if (memcmp(&scene, &rtc.scene, sizeof(scene))) {
+			memcpy(&rtc.scene, &scene, sizeof(scene));
+			rtc.crc = scene_crc(&scene);
+			settled = 0;
+			saved = false;
+		} else if (!saved && (settled += SCENE_POLL_MS) >= SCENE_SAVE_MS) {
+			scene_save(&scene);
+			saved = true;
+		}
+	}
+}
+
+void scene_init()
+{
+	ESP_ERROR_CHECK(scene_nvs_init());
+	SYSMON_TASK_CREATE(scene_loop, "scene", SCENE_TASK_STACK, NULL, 1, &scene_task, tskNO_AFFINITY);
+}
+#endif
@@ -0,0 +1,34 @@
+#ifndef SCENE_H
+#define SCENE_H
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "led_layers.h"
+#include "led_patterns.h"
+
+/* Goes up whenever a field changes meaning, a scene from another version is ignored */
+#define SCENE_VERSION		2
+
+/*
+ * The patterns and colours showing, kept in RTC memory as they change and in
+ * NVS once they settle, so a unit that resets or browns out mid-show comes
+ * back with the same look. RTC memory survives anything but losing power.
+ * Patterns go by name, so a build that adds or reorders them still finds
+ * the same ones.
+ */
+typedef struct {
+	uint32_t hue;
+	uint32_t hue2;
+	uint32_t period_us;
+	uint8_t version;
+	uint8_t intensity;
+	uint8_t palette;
+	char pattern[LED_NUM_LAYERS][LED_PATTERN_NAME_LEN];	/* empty for none */
+	uint8_t blend[LED_NUM_LAYERS];
+	uint8_t opacity[LED_NUM_LAYERS];
+} scene_t;
+
+bool scene_restore(void);
+void scene_init(void);
+
+#endif /* SCENE_H */
@@ -0,0 +1,409 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "leds.h"
+#include "led_layers.h"
+#include "led_patterns.h"
+#include "sync.h"
+#include "sysmon.h"
+
+#define TAG "sync"
+
+#define SYNC_MAGIC		0x5854	/* "TX" */
+#define SYNC_VERSION		1
+#define SYNC_LOOP_MS		20
+#define SYNC_PING_MS		250
+#define SYNC_STATE_MS		1000
+#define SYNC_PEER_TIMEOUT_MS	3000
+#define SYNC_MAX_PEERS		8
+#define SYNC_SAMPLES		8
+#define SYNC_MAX_RTT_US		20000
+#define SYNC_LEAD_US		50000	/* how far ahead tempo changes and resyncs start */
+#define SYNC_NO_PATTERN		0xff
+#define SYNC_TASK_STACK		4096
+
+typedef enum {
+	SYNC_MSG_PING,
+	SYNC_MSG_PONG,
+	SYNC_MSG_STATE,
+} sync_msg_type_t;
+
+/* Every message starts with this, which is also how units learn of each other */
+typedef struct __attribute__((packed)) {
+	uint16_t magic;
+	uint8_t version;
+	uint8_t type;
+	uint32_t node;
+	uint8_t priority;
+	uint8_t reserved[3];
+} sync_hdr_t;
+
+/* t1 follower send, t2 leader receive, t3 leader send, t2 and t3 on the shared clock */
+typedef struct __attribute__((packed)) {
+	sync_hdr_t hdr;
+	uint32_t to;
+	int64_t t1, t2, t3;
+} sync_clock_msg_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t pattern;	/* index into get_patterns() */
+	uint8_t blend;
+	uint8_t opacity;
+	uint8_t reserved;
+	int64_t start;		/* shared clock */
+} sync_layer_t;
+
+typedef struct __attribute__((packed)) {
+	int64_t epoch;		/* shared clock time of a beat */
+	uint32_t period_us;
+	uint16_t hue, hue2;
+	uint8_t intensity;
+	uint8_t palette;
+	uint8_t reserved[2];
+	sync_layer_t layers[LED_NUM_LAYERS];
+} sync_params_t;
+
+/* Every change bumps seq, on a tie the leader's state wins */
+typedef struct __attribute__((packed)) {
+	sync_hdr_t hdr;
+	uint32_t seq;
+	sync_params_t params;
+} sync_state_msg_t;
+
+typedef union {
+	sync_hdr_t hdr;
+	sync_clock_msg_t clock;
+	sync_state_msg_t state;
+	uint8_t raw[SYNC_TRANSPORT_MTU];
+} sync_msg_t;
+
+typedef struct {
+	uint32_t node;
+	uint8_t priority;
+	int64_t seen;
+} sync_peer_t;
+
+typedef struct {
+	int64_t offset;
+	int64_t rtt;
+} sync_sample_t;
+
+static sync_transport_t* transport;
+static uint32_t self;
+static uint32_t leader;
+static sync_peer_t peers[SYNC_MAX_PEERS];
+static uint8_t num_peers = 0;
+static sync_sample_t samples[SYNC_SAMPLES];
+static uint8_t num_samples = 0, next_sample = 0;
+static int64_t offset = 0;
+static portMUX_TYPE offset_mux = portMUX_INITIALIZER_UNLOCKED;
+static sync_params_t params;
+static uint32_t seq = 0;
+static bool resync = false;
+/* The last state heard before this unit's clock was on the leader's */
+static sync_state_msg_t held;
+static bool holding = false;
+
+int64_t sync_get_offset()
+{
+	portENTER_CRITICAL(&offset_mux);
+	int64_t ret = offset;
+	portEXIT_CRITICAL(&offset_mux);
+	return ret;
+}
+
+static void sync_set_offset(int64_t new)
+{
+	int64_t jump = new - offset;
+	if (jump > SYNC_STEP_US || jump < -SYNC_STEP_US) {
+		/* Onto a new leader's clock, everything timed on the old one moves with it */
+		led_layers_shift(jump);
+		params.epoch += jump;
+		for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+			params.layers[l].start += jump;
+		}
+	}
+	portENTER_CRITICAL(&offset_mux);
+	offset = new;
+	portEXIT_CRITICAL(&offset_mux);
+}
+
+bool sync_is_leader()
+{
+	return leader == self;
+}
+
+uint8_t sync_num_peers()
+{
+	return num_peers;
+}
+
+static void sync_send(sync_msg_t* msg, sync_msg_type_t type, size_t len)
+{
+	msg->hdr = (sync_hdr_t) {
+		.magic = SYNC_MAGIC,
+		.version = SYNC_VERSION,
+		.type = type,
+		.node = self,
+		.priority = CONFIG_LED_SYNC_PRIORITY,
+	};
+	if (transport->send(transport, msg, len) != ESP_OK) {
+		ESP_LOGD(TAG, "send %u failed", type);
+	}
+}
+
+/* Lower priority wins, then lower id */
+static bool sync_beats(uint8_t priority, uint32_t node, uint8_t other_priority, uint32_t other)
+{
+	return (priority != other_priority) ? (priority < other_priority) : (node < other);
+}
+
+static void sync_peer_seen(const sync_hdr_t* hdr, int64_t now)
+{
+	for (uint8_t i = 0; i < num_peers; i++) {
+		if (peers[i].node == hdr->node) {
+			peers[i].priority = hdr->priority;
+			peers[i].seen = now;
+			return;
+		}
+	}
+	if (num_peers < SYNC_MAX_PEERS) {
+		ESP_LOGI(TAG, "unit %08x joined", hdr->node);
+		peers[num_peers++] = (sync_peer_t) { hdr->node, hdr->priority, now };
+		/* Bring the newcomer's patterns into step with everyone else's */
+		resync = true;
+	}
+}
+
+static void sync_elect(int64_t now)
+{
+	uint8_t best_priority = CONFIG_LED_SYNC_PRIORITY;
+	uint32_t best = self;
+	for (uint8_t i = 0; i < num_peers; i++) {
+		if (now - peers[i].seen > SYNC_PEER_TIMEOUT_MS * 1000) {
+			ESP_LOGI(TAG, "unit %08x left", peers[i].node);
+			peers[i--] = peers[--num_peers];
+			continue;
+		}
+		if (sync_beats(peers[i].priority, peers[i].node, best_priority, best)) {
+			best_priority = peers[i].priority;
+			best = peers[i].node;
+		}
+	}
+	if (best != leader) {
+		ESP_LOGI(TAG, "leader is %08x%s", best, (best == self) ? " (this unit)" : "");
+		leader = best;
+		num_samples = 0;
+		next_sample = 0;
+	}
+}
+
+/* NTP style, the sample with the shortest round trip has the least queueing in it */
+static void sync_clock_sample(const sync_clock_msg_t* pong, int64_t t4)
+{
+	int64_t rtt = (t4 - pong->t1) - (pong->t3 - pong->t2);
+	if (rtt < 0 || rtt > SYNC_MAX_RTT_US) {
+		return;
+	}
+	samples[next_sample] = (sync_sample_t) { ((pong->t2 - pong->t1) + (pong->t3 - t4)) / 2, rtt };
+	next_sample = (next_sample + 1) % SYNC_SAMPLES;
+	if (num_samples < SYNC_SAMPLES) {
+		num_samples++;
+	}
+	const sync_sample_t* best = &samples[0];
+	for (uint8_t i = 1; i < num_samples; i++) {
+		if (samples[i].rtt < best->rtt) {
+			best = &samples[i];
+		}
+	}
+	sync_set_offset(best->offset);
+	ESP_LOGD(TAG, "offset %lld us, rtt %lld us", best->offset, best->rtt);
+}
+
+static void sync_get_params(sync_params_t* p)
+{
+	led_pattern_t* patterns = get_patterns();
+	memset(p, 0, sizeof(*p));
+	p->epoch = params.epoch;
+	p->period_us = led_get_period_us();
+	p->hue = led_get_primary_hue();
+	p->hue2 = led_get_secondary_hue();
+	p->intensity = led_get_intensity();
+	p->palette = led_get_palette_index();
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		led_layer_params_t layer;
+		led_get_layer_params(l, &layer);
+		p->layers[l].pattern = layer.pattern ? (layer.pattern - patterns) : SYNC_NO_PATTERN;
+		p->layers[l].blend = layer.blend;
+		p->layers[l].opacity = layer.opacity;
+		p->layers[l].start = layer.start;
+	}
+}
+
+static void sync_set_layer(uint8_t l, const sync_layer_t* layer)
+{
+	led_layer_params_t new = {
+		.pattern = (layer->pattern < LED_NUM_PATTERNS) ? &get_patterns()[layer->pattern] : NULL,
+		.blend = layer->blend,
+		.opacity = layer->opacity,
+		.start = layer->start,
+	};
+	led_set_layer_params(l, &new);
+}
+
+/* Start every running layer over at start, on every unit */
+static void sync_restart(sync_params_t* p, int64_t start)
+{
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		if (p->layers[l].pattern != SYNC_NO_PATTERN) {
+			p->layers[l].start = start;
+			sync_set_layer(l, &p->layers[l]);
+		}
+	}
+}
+
+static void sync_send_state()
+{
+	sync_msg_t msg;
+	msg.state.seq = seq;
+	msg.state.params = params;
+	sync_send(&msg, SYNC_MSG_STATE, sizeof(msg.state));
+}
+
+static void sync_apply(const sync_state_msg_t* state)
+{
+	bool from_leader = (state->hdr.node == leader);
+	if (!sync_is_leader() && !num_samples) {
+		/* Its start times are on the leader's clock, wait until this unit's is too */
+		held = *state;
+		holding = true;
+		return;
+	}
+	if (state->seq < seq) {
+		/* The leader missed a change of ours */
+		if (from_leader) {
+			sync_send_state();
+		}
+		return;
+	}
+	if (state->seq == seq && (!from_leader || !memcmp(&state->params, &params, sizeof(params)))) {
+		return;
+	}
+	const sync_params_t* p = &state->params;
+	led_set_period_us(p->period_us);
+	led_set_primary_hue(p->hue);
+	led_set_secondary_hue(p->hue2);
+	led_set_intensity(p->intensity);
+	led_set_palette(p->palette);
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		if (memcmp(&p->layers[l], &params.layers[l], sizeof(sync_layer_t))) {
+			sync_set_layer(l, &p->layers[l]);
+		}
+	}
+	params = *p;
+	seq = state->seq;
+}
+
+/* Broadcast anything changed here, e.g. from the UI */
+static void sync_check_local()
+{
+	sync_params_t cur;
+	sync_get_params(&cur);
+	if (cur.period_us != params.period_us) {
+		/* New tempo, start the beat over a little ahead so everyone gets there together */
+		cur.epoch = led_get_time() + SYNC_LEAD_US;
+		sync_restart(&cur, cur.epoch);
+	}
+	if (resync && sync_is_leader()) {
+		int64_t now = led_get_time() + SYNC_LEAD_US;
+		int64_t beats = (now - cur.epoch) / cur.period_us + 1;
+		sync_restart(&cur, cur.epoch + beats * cur.period_us);
+	}
+	resync = false;
+	if (memcmp(&cur, &params, sizeof(cur))) {
+		params = cur;
+		seq++;
+		sync_send_state();
+	}
+}
+
+static void sync_handle(sync_msg_t* msg, int len, int64_t time)
+{
+	if (len < (int)sizeof(sync_hdr_t) || msg->hdr.magic != SYNC_MAGIC ||
+	    msg->hdr.version != SYNC_VERSION || msg->hdr.node == self) {
+		return;
+	}
+	sync_peer_seen(&msg->hdr, time);
+	switch (msg->hdr.type) {
+	case SYNC_MSG_PING:
+		if (len >= sizeof(sync_clock_msg_t) && msg->clock.to == self) {
+			msg->clock.to = msg->hdr.node;
+			msg->clock.t2 = time + sync_get_offset();
+			msg->clock.t3 = led_get_time();
+			sync_send(msg, SYNC_MSG_PONG, sizeof(msg->clock));
+		}
+		break;
+	case SYNC_MSG_PONG:
+		if (len >= sizeof(sync_clock_msg_t) && msg->clock.to == self && msg->hdr.node == leader) {
+			sync_clock_sample(&msg->clock, time);
+			if (holding && num_samples) {
+				holding = false;
+				sync_apply(&held);
+			}
+		}
+		break;
+	case SYNC_MSG_STATE:
+		if (len >= sizeof(sync_state_msg_t)) {
+			sync_apply(&msg->state);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void sync_loop(void* parameters)
+{
+	sync_msg_t msg;
+	int64_t time, last_ping = 0, last_state = 0;
+
+	while (true) {
+		int len = transport->recv(transport, &msg, sizeof(msg), &time, SYNC_LOOP_MS);
+		if (len > 0) {
+			sync_handle(&msg, len, time);
+		}
+		int64_t now = esp_timer_get_time();
+		sync_elect(now);
+		sync_check_local();
+		if (sync_is_leader()) {
+			/* Heartbeat, so new units hear about the leader and its state */
+			if (now - last_state >= SYNC_STATE_MS * 1000) {
+				last_state = now;
+				sync_send_state();
+			}
+		} else if (now - last_ping >= SYNC_PING_MS * 1000) {
+			last_ping = now;
+			msg.clock.to = leader;
+			msg.clock.t1 = esp_timer_get_time();
+			sync_send(&msg, SYNC_MSG_PING, sizeof(msg.clock));
+		}
+	}
+}
+
+void sync_init(sync_transport_t* new)
+{
+	static TaskHandle_t sync_task;
+	ESP_ERROR_CHECK(new ? ESP_OK : ESP_FAIL);
+	transport = new;
+	self = esp_random();
+	leader = self;
+	sync_get_params(&params);
+	ESP_LOGI(TAG, "unit %08x, priority %u", self, CONFIG_LED_SYNC_PRIORITY);
+	SYSMON_TASK_CREATE(sync_loop, "sync", SYNC_TASK_STACK, NULL, 3, &sync_task, 0);
+}
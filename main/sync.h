@@ -0,0 +1,23 @@
+#ifndef SYNC_H
+#define SYNC_H
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sync_transport.h"
+
+/* Offset changes bigger than this are a new leader's clock, smaller ones pull the deadlines into line */
+#define SYNC_STEP_US	10000
+
+/*
+ * Units elect the one with the lowest (priority, id) as leader and estimate
+ * the offset of their esp_timer clock to the leader's from ping round trips,
+ * keeping the sample with the shortest round trip. Pattern, tempo and colour
+ * changes on any unit are broadcast with layer start times on that shared
+ * clock, so every unit steps its patterns at the same instants.
+ */
+void sync_init(sync_transport_t* transport);
+int64_t sync_get_offset(void);
+bool sync_is_leader(void);
+uint8_t sync_num_peers(void);
+
+#endif /* SYNC_H */
@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_timer.h"
+
+#include "net.h"
+#include "sync_transport.h"
+
+#define TAG "sync_espnow"
+
+#define ESPNOW_QUEUE_LEN	8
+
+typedef struct {
+	int64_t time;
+	uint8_t len;
+	uint8_t data[SYNC_TRANSPORT_MTU];
+} espnow_rx_t;
+
+typedef struct {
+	sync_transport_t parent;
+	QueueHandle_t rx;
+} espnow_t;
+
+static const uint8_t broadcast[ESP_NOW_ETH_ALEN] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+/* The receive callback has no context argument */
+static espnow_t* espnow = NULL;
+
+/* Runs in the Wi-Fi task, so stamp the time here rather than when the sync task gets to it */
+static void espnow_recv_cb(const uint8_t* mac, const uint8_t* data, int len)
+{
+	espnow_rx_t rx = { .time = esp_timer_get_time() };
+	if (len <= 0 || len > SYNC_TRANSPORT_MTU) {
+		return;
+	}
+	rx.len = len;
+	memcpy(rx.data, data, len);
+	xQueueSend(espnow->rx, &rx, 0);
+}
+
+static esp_err_t espnow_send(sync_transport_t* transport, const void* msg, size_t len)
+{
+	return esp_now_send(broadcast, msg, len);
+}
+
+static int espnow_recv(sync_transport_t* transport, void* buf, size_t len, int64_t* time, uint32_t timeout_ms)
+{
+	espnow_t* t = __containerof(transport, espnow_t, parent);
+	espnow_rx_t rx;
+	if (xQueueReceive(t->rx, &rx, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+		return -1;
+	}
+	len = (rx.len < len) ? rx.len : len;
+	memcpy(buf, rx.data, len);
+	*time = rx.time;
+	return len;
+}
+
+static void espnow_del(sync_transport_t* transport)
+{
+	espnow_t* t = __containerof(transport, espnow_t, parent);
+	esp_now_deinit();
+	vQueueDelete(t->rx);
+	free(t);
+	espnow = NULL;
+}
+
+/* ESP-NOW only needs the radio, net_init() doesn't have to connect anywhere */
+sync_transport_t* sync_transport_new_espnow(uint8_t channel)
+{
+	wifi_interface_t iface = net_init(channel);
+
+	espnow = calloc(1, sizeof(espnow_t));
+	ESP_ERROR_CHECK(espnow ? ESP_OK : ESP_ERR_NO_MEM);
+	espnow->rx = xQueueCreate(ESPNOW_QUEUE_LEN, sizeof(espnow_rx_t));
+	ESP_ERROR_CHECK(espnow->rx ? ESP_OK : ESP_ERR_NO_MEM);
+
+	ESP_ERROR_CHECK(esp_now_init());
+	ESP_ERROR_CHECK(esp_now_register_recv_cb(espnow_recv_cb));
+	esp_now_peer_info_t peer = {
+		.channel = channel,
+		.ifidx = iface,
+		.encrypt = false,
+	};
+	memcpy(peer.peer_addr, broadcast, ESP_NOW_ETH_ALEN);
+	ESP_ERROR_CHECK(esp_now_add_peer(&peer));
+
+	espnow->parent.send = espnow_send;
+	espnow->parent.recv = espnow_recv;
+	espnow->parent.del = espnow_del;
+	ESP_LOGI(TAG, "ESP-NOW on channel %u", channel);
+	return &espnow->parent;
+}
@@ -0,0 +1,26 @@
+#ifndef SYNC_TRANSPORT_H
+#define SYNC_TRANSPORT_H
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * A transport broadcasts datagrams to every unit in range, including ones
+ * that join later. Messages from this unit may or may not come back.
+ */
+typedef struct sync_transport_s sync_transport_t;
+
+struct sync_transport_s {
+	/* send msg to every unit */
+	esp_err_t (*send)(sync_transport_t* transport, const void* msg, size_t len);
+	/* wait up to timeout_ms for a message, returns its length or -1, and esp_timer time it arrived */
+	int (*recv)(sync_transport_t* transport, void* buf, size_t len, int64_t* time, uint32_t timeout_ms);
+	void (*del)(sync_transport_t* transport);
+};
+
+#define SYNC_TRANSPORT_MTU	250	/* the ESP-NOW limit */
+
+sync_transport_t* sync_transport_new_espnow(uint8_t channel);
+sync_transport_t* sync_transport_new_udp(const char* group, uint16_t port);
+
+#endif /* SYNC_TRANSPORT_H */
@@ -0,0 +1,110 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "sync_transport.h"
+
+#define TAG "sync_udp"
+
+/*
+ * UDP multicast with loopback enabled, so any number of units, real or
+ * simulated on one machine, can share a group as long as a network is up.
+ */
+typedef struct {
+	sync_transport_t parent;
+	int sock;
+	struct sockaddr_in group;
+} udp_t;
+
+static esp_err_t udp_send(sync_transport_t* transport, const void* msg, size_t len)
+{
+	udp_t* t = __containerof(transport, udp_t, parent);
+	if (sendto(t->sock, msg, len, 0, (struct sockaddr*)&t->group, sizeof(t->group)) != len) {
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
+
+static int udp_recv(sync_transport_t* transport, void* buf, size_t len, int64_t* time, uint32_t timeout_ms)
+{
+	udp_t* t = __containerof(transport, udp_t, parent);
+	struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(t->sock, &fds);
+	if (select(t->sock + 1, &fds, NULL, NULL, &tv) <= 0) {
+		return -1;
+	}
+	int ret = recv(t->sock, buf, len, 0);
+	*time = esp_timer_get_time();
+	return ret;
+}
+
+static void udp_del(sync_transport_t* transport)
+{
+	udp_t* t = __containerof(transport, udp_t, parent);
+	close(t->sock);
+	free(t);
+}
+
+sync_transport_t* sync_transport_new_udp(const char* group, uint16_t port)
+{
+	udp_t* t = calloc(1, sizeof(udp_t));
+	if (!t) {
+		return NULL;
+	}
+	t->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (t->sock < 0) {
+		ESP_LOGE(TAG, "no socket");
+		goto err;
+	}
+	int on = 1;
+	setsockopt(t->sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+	setsockopt(t->sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#endif
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+	if (bind(t->sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		ESP_LOGE(TAG, "can't bind port %u", port);
+		goto err;
+	}
+	struct ip_mreq mreq = {
+		.imr_multiaddr.s_addr = inet_addr(group),
+		.imr_interface.s_addr = htonl(INADDR_ANY),
+	};
+	uint8_t loop = 1;
+	if (setsockopt(t->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+	    setsockopt(t->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0) {
+		ESP_LOGE(TAG, "can't join %s", group);
+		goto err;
+	}
+	t->group = (struct sockaddr_in) {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = inet_addr(group),
+	};
+
+	t->parent.send = udp_send;
+	t->parent.recv = udp_recv;
+	t->parent.del = udp_del;
+	ESP_LOGI(TAG, "UDP on %s:%u", group, port);
+	return &t->parent;
+err:
+	if (t->sock >= 0) {
+		close(t->sock);
+	}
+	free(t);
+	return NULL;
+}
@@ -0,0 +1,58 @@
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "sysmon.h"
+
+#define TAG "sysmon"
+
+#define SYSMON_MAX_TASKS	8
+
+static TaskHandle_t tasks[SYSMON_MAX_TASKS];
+static uint8_t num_tasks = 0;
+
+void sysmon_add_task(TaskHandle_t task)
+{
+	if (task && num_tasks < SYSMON_MAX_TASKS) {
+		tasks[num_tasks++] = task;
+	}
+}
+
+void sysmon_report()
+{
+	for (uint8_t i = 0; i < num_tasks; i++) {
+		/* ESP-IDF stacks are in bytes */
+		ESP_LOGI(TAG, "%-12s stack %u bytes never used", pcTaskGetTaskName(tasks[i]),
+			 uxTaskGetStackHighWaterMark(tasks[i]));
+	}
+	ESP_LOGI(TAG, "heap %u free, %u at the lowest, %u largest block",
+		 heap_caps_get_free_size(MALLOC_CAP_8BIT),
+		 heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+		 heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+#if CONFIG_LED_MEM_REPORT_PERIOD
+static void sysmon_timer(TimerHandle_t timer)
+{
+	sysmon_report();
+}
+#endif
+
+void sysmon_init()
+{
+	sysmon_report();
+#if CONFIG_LED_MEM_REPORT_PERIOD
+	TickType_t period = pdMS_TO_TICKS(CONFIG_LED_MEM_REPORT_PERIOD * 1000);
+	TimerHandle_t timer;
+#if CONFIG_LED_STATIC_ALLOC
+	static StaticTimer_t timer_buf;
+	timer = xTimerCreateStatic("sysmon", period, pdTRUE, NULL, sysmon_timer, &timer_buf);
+#else
+	timer = xTimerCreate("sysmon", period, pdTRUE, NULL, sysmon_timer);
+#endif
+	xTimerStart(timer, 0);
+#endif
+}
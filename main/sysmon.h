@@ -0,0 +1,29 @@
+#ifndef SYSMON_H
+#define SYSMON_H
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Create a task pinned to a core and add it to the memory report. With
+ * CONFIG_LED_STATIC_ALLOC the stack and TCB are static, one set per call site.
+ */
+#if CONFIG_LED_STATIC_ALLOC
+#define SYSMON_TASK_CREATE(fn, name, stack, param, prio, handle, core) do {	\
+	static StackType_t fn##_stack[stack];					\
+	static StaticTask_t fn##_tcb;						\
+	*(handle) = xTaskCreateStaticPinnedToCore(fn, name, stack, param, prio,	\
+						  fn##_stack, &fn##_tcb, core);	\
+	sysmon_add_task(*(handle));						\
+} while (0)
+#else
+#define SYSMON_TASK_CREATE(fn, name, stack, param, prio, handle, core) do {	\
+	xTaskCreatePinnedToCore(fn, name, stack, param, prio, handle, core);	\
+	sysmon_add_task(*(handle));						\
+} while (0)
+#endif
+
+void sysmon_add_task(TaskHandle_t task);
+void sysmon_report(void);
+void sysmon_init(void);
+
+#endif /* SYSMON_H */
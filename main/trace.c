@@ -0,0 +1,162 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "sysmon.h"
+#include "trace.h"
+
+#if CONFIG_LED_TRACE
+#define TAG "trace"
+
+#define TRACE_TASK_STACK	3072
+#define TRACE_MAX_TASKS		32
+#define TRACE_MASK		(CONFIG_LED_TRACE_EVENTS - 1)
+
+_Static_assert((CONFIG_LED_TRACE_EVENTS & TRACE_MASK) == 0, "CONFIG_LED_TRACE_EVENTS must be a power of two");
+
+static const char* const trace_names[TRACE_NUM_IDS] = {
+	[TRACE_ID_FRAME] = "frame",
+	[TRACE_ID_REFRESH] = "refresh",
+	[TRACE_ID_OLED] = "OLED",
+	[TRACE_ID_RMT_ISR] = "RMT",
+	[TRACE_ID_GPIO_ISR] = "GPIO",
+};
+
+static trace_event_t events[CONFIG_LED_TRACE_EVENTS];
+/* Events recorded since the last dump, the ring holds the newest of them */
+static uint32_t head = 0;
+static volatile bool recording = false;
+static TaskHandle_t trace_task = NULL;
+/* The tasks alive at the last dump, with their names copied out of the TCBs */
+static TaskStatus_t task_status[TRACE_MAX_TASKS];
+static char task_names[TRACE_MAX_TASKS][configMAX_TASK_NAME_LEN];
+static UBaseType_t num_task_status = 0;
+
+/* Any task or interrupt on either core, so slots are claimed with an atomic add and never locked */
+void IRAM_ATTR trace_record(trace_event_type_t type, uint32_t arg)
+{
+	if (!recording) {
+		return;
+	}
+	trace_event_t* e = &events[__atomic_fetch_add(&head, 1, __ATOMIC_RELAXED) & TRACE_MASK];
+	e->time = esp_timer_get_time();
+	e->arg = arg;
+	e->type = type;
+	e->core = xPortGetCoreID();
+}
+
+/* From the scheduler, see trace_hooks.h */
+void IRAM_ATTR trace_task_in(void* task)
+{
+	trace_record(TRACE_EVENT_TASK_IN, (uintptr_t)task);
+}
+
+void IRAM_ATTR trace_task_out(void* task)
+{
+	trace_record(TRACE_EVENT_TASK_OUT, (uintptr_t)task);
+}
+
+/* The strip driver calls this around every refill from its interrupt */
+void IRAM_ATTR led_strip_rmt_isr_hook(bool enter)
+{
+	trace_record(enter ? TRACE_EVENT_ISR_ENTER : TRACE_EVENT_ISR_EXIT, TRACE_ID_RMT_ISR);
+}
+
+/*
+ * Handles in the ring may belong to tasks deleted since, whose TCBs are
+ * freed, so they are only ever compared against the live ones. With more
+ * than TRACE_MAX_TASKS tasks there is no snapshot and every name is "?".
+ */
+static void trace_snapshot_tasks(void)
+{
+	num_task_status = uxTaskGetSystemState(task_status, TRACE_MAX_TASKS, NULL);
+	for (UBaseType_t i = 0; i < num_task_status; i++) {
+		if (task_status[i].eCurrentState == eDeleted) {
+			task_names[i][0] = '\0';
+		} else {
+			snprintf(task_names[i], sizeof(task_names[i]), "%s", task_status[i].pcTaskName);
+		}
+	}
+}
+
+static const char* trace_task_name(TaskHandle_t task)
+{
+	for (UBaseType_t i = 0; i < num_task_status; i++) {
+		if (task_status[i].xHandle == task && task_names[i][0]) {
+			return task_names[i];
+		}
+	}
+	return "?";
+}
+
+static void trace_dump(void)
+{
+	TaskHandle_t tasks[TRACE_MAX_TASKS];
+	uint8_t num_tasks = 0;
+	recording = false;
+	/* Let anything that got past the check finish writing */
+	vTaskDelay(1);
+	trace_snapshot_tasks();
+	uint32_t end = head;
+	uint32_t start = (end > CONFIG_LED_TRACE_EVENTS) ? end - CONFIG_LED_TRACE_EVENTS : 0;
+
+	printf("TRACE_DUMP %u %u\n", end - start, start);
+	for (uint8_t i = 0; i < TRACE_NUM_IDS; i++) {
+		printf("TRACE_ID %u %s\n", i, trace_names[i]);
+	}
+	for (uint32_t i = start; i < end; i++) {
+		const trace_event_t* e = &events[i & TRACE_MASK];
+		if (e->type == TRACE_EVENT_TASK_IN && num_tasks < TRACE_MAX_TASKS) {
+			uint8_t t = 0;
+			while (t < num_tasks && tasks[t] != (TaskHandle_t)(uintptr_t)e->arg) {
+				t++;
+			}
+			if (t == num_tasks) {
+				tasks[num_tasks++] = (TaskHandle_t)(uintptr_t)e->arg;
+				printf("TRACE_TASK %08x %s\n", e->arg, trace_task_name(tasks[t]));
+			}
+		}
+	}
+	for (uint32_t i = start; i < end; i++) {
+		const trace_event_t* e = &events[i & TRACE_MASK];
+		printf("TRACE %u %u %u %x\n", e->core, e->type, e->time, e->arg);
+	}
+	printf("TRACE_DONE\n");
+	head = 0;
+	recording = true;
+}
+
+static void trace_loop(void* arg)
+{
+#if CONFIG_LED_TRACE_PERIOD
+	TickType_t period = pdMS_TO_TICKS(CONFIG_LED_TRACE_PERIOD * 1000);
+#else
+	TickType_t period = portMAX_DELAY;
+#endif
+	while (true) {
+		/* Overruns cut the wait short, so the trace ends just after one */
+		if (ulTaskNotifyTake(pdTRUE, period)) {
+			ESP_LOGW(TAG, "Frame overran, dumping the trace");
+		}
+		trace_dump();
+	}
+}
+
+void trace_dump_request()
+{
+	if (trace_task) {
+		xTaskNotifyGive(trace_task);
+	}
+}
+
+void trace_init()
+{
+	recording = true;
+	SYSMON_TASK_CREATE(trace_loop, "trace", TRACE_TASK_STACK, NULL, 1, &trace_task, tskNO_AFFINITY);
+}
+#endif
@@ -0,0 +1,54 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Task switches, interrupts and marked spans go into a ring buffer with
+ * microsecond timestamps. It is printed on the console every so often and
+ * after a frame overruns, for tools/trace_export.py to turn into a Chrome
+ * trace. The marks compile to nothing without CONFIG_LED_TRACE.
+ */
+typedef enum {
+	TRACE_EVENT_TASK_IN,
+	TRACE_EVENT_TASK_OUT,
+	TRACE_EVENT_ISR_ENTER,
+	TRACE_EVENT_ISR_EXIT,
+	TRACE_EVENT_BEGIN,
+	TRACE_EVENT_END,
+} trace_event_type_t;
+
+/* Interrupts and spans, named in trace.c */
+typedef enum {
+	TRACE_ID_FRAME,		/* LED task rendering and sending whatever is due */
+	TRACE_ID_REFRESH,	/* sending it to the strip */
+	TRACE_ID_OLED,		/* UI writing the status lines */
+	TRACE_ID_RMT_ISR,	/* strip refills */
+	TRACE_ID_GPIO_ISR,	/* buttons */
+	TRACE_NUM_IDS
+} trace_id_t;
+
+typedef struct {
+	uint32_t time;		/* us, esp_timer */
+	uint32_t arg;		/* task handle or trace_id_t */
+	uint8_t type;
+	uint8_t core;
+} trace_event_t;
+
+#if CONFIG_LED_TRACE
+#define TRACE_BEGIN(id)		trace_record(TRACE_EVENT_BEGIN, id)
+#define TRACE_END(id)		trace_record(TRACE_EVENT_END, id)
+#define TRACE_ISR_ENTER(id)	trace_record(TRACE_EVENT_ISR_ENTER, id)
+#define TRACE_ISR_EXIT(id)	trace_record(TRACE_EVENT_ISR_EXIT, id)
+#else
+#define TRACE_BEGIN(id)
+#define TRACE_END(id)
+#define TRACE_ISR_ENTER(id)
+#define TRACE_ISR_EXIT(id)
+#endif
+
+void trace_record(trace_event_type_t type, uint32_t arg);
+void trace_dump_request(void);
+void trace_init(void);
+
+#endif /* TRACE_H */
@@ -0,0 +1,23 @@
+#ifndef TRACE_HOOKS_H
+#define TRACE_HOOKS_H
+/*
+ * With CONFIG_LED_TRACE this is included ahead of every file in the build,
+ * see CMakeLists.txt and Makefile.projbuild, so the FreeRTOS scheduler
+ * reports task switches to trace.c. The hooks only expand inside tasks.c,
+ * where pxCurrentTCB lives.
+ */
+#ifndef __ASSEMBLER__
+#ifdef __cplusplus
+extern "C" {
+#endif
+void trace_task_in(void* task);
+void trace_task_out(void* task);
+#ifdef __cplusplus
+}
+#endif
+
+#define traceTASK_SWITCHED_IN()		trace_task_in(pxCurrentTCB[xPortGetCoreID()])
+#define traceTASK_SWITCHED_OUT()	trace_task_out(pxCurrentTCB[xPortGetCoreID()])
+#endif /* __ASSEMBLER__ */
+
+#endif /* TRACE_HOOKS_H */
@@ -11,15 +11,26 @@
 #include "ssd1306.h"
 #include "font8x8_basic.h"
 
+#include "latency.h"
 #include "leds.h"
 #include "led_patterns.h"
+#include "palette.h"
+#include "sysmon.h"
+#include "trace.h"
 #include "ui_buttons.h"
 #include "ui.h"
 
 #define TAG "UI"
 
+#if CONFIG_LED_POWER_SAVE
+/* Fewer status updates, so the CPU can sleep longer */
+#define UI_LOOP_PERIOD		500
+#else
 #define UI_LOOP_PERIOD		100
+#endif
 #define UI_IDLE_TIMEOUT		5000
+#define UI_SPLASH_MS		1000
+#define UI_TASK_STACK		4096
 
 typedef enum {
 	UI_STATE_OFF,
@@ -28,14 +39,21 @@ typedef enum {
 	UI_STATE_TEMPO,
 	UI_STATE_COLOR,
 	UI_STATE_INTENSITY,
+	UI_STATE_PALETTE,
 	UI_STATE_MAX
 } ui_state_t;
 
 static ui_state_t state = UI_STATE_IDLE;
 static ui_menu_t* cur_menu = NULL;
 static TaskHandle_t ui_task = NULL;
+/* The UI task keeps using this after ui_init returns */
+static SSD1306_t oled;
 static uint32_t cur_avg = 0;
 static uint8_t avg_samples = 0;
+#if LED_NUM_ZONES > 1
+/* The zone the pattern menu sets, LED_NUM_ZONES for all of them */
+static uint8_t ui_zone = LED_NUM_ZONES;
+#endif
 
 /* Helper functions */
 uint8_t ui_change_state(ui_state_t new_state)
@@ -61,7 +79,7 @@ uint8_t ui_show_menu(SSD1306_t* dev, ui_menu_t* menu, uint8_t menu_items, int8_t
 		uint8_t start = ((menu->selection >= 7) ? menu->selection : 0);
 		uint8_t end = (((start + 7) > menu_items) ? menu_items : (start + 7));
 		/* backtrack a bit in case the number of items is not a multiple of 7 */
-		if (end - start < 7) {
+		if (end - start < 7 && end >= 7) {
 			start = end - 7;
 		}
 		ESP_LOGD(TAG, "generating menu from %u to %u selection %u items %u", start, end, menu->selection, menu_items);
@@ -116,11 +134,6 @@ void ui_loop(void* parameters)
 	ssd1306_clear_screen(dev, false);
 	ssd1306_display_text(dev, 0, "    tubalux", 11, false);
 	ssd1306_hardware_scroll(dev, SCROLL_DOWN);
-	vTaskDelay(pdMS_TO_TICKS(1000));
-	ssd1306_hardware_scroll(dev, SCROLL_UP);
-	vTaskDelay(pdMS_TO_TICKS(1000));
-	ssd1306_hardware_scroll(dev, SCROLL_STOP);
-	ssd1306_clear_screen(dev, false);
 
 	/* Battery ADC setup */
 	uint32_t voltage = 0;
@@ -132,27 +145,53 @@ void ui_loop(void* parameters)
 	char bpm_str[17];
 	uint32_t idle_timer = 0;
 	uint32_t buttons = 0;
+	uint8_t splash = 2;	/* scrolls of the splash left to show */
 	TickType_t before, after;
 
 	while (true) {
+		if (splash) {
+			/* The splash scrolls down and back up, a button press cuts it short and counts */
+			if (xTaskNotifyWait(0, UINT32_MAX, &buttons, pdMS_TO_TICKS(UI_SPLASH_MS)) == pdFALSE && --splash) {
+				ssd1306_hardware_scroll(dev, SCROLL_UP);
+				continue;
+			}
+			ssd1306_hardware_scroll(dev, SCROLL_STOP);
+			ssd1306_clear_screen(dev, false);
+			splash = 0;
+		}
 		before = xTaskGetTickCount();
 		/* Disable interrupts for GPIO36 and 39 before ADC read. See Errata 3.11 */
 		ui_isr_disable();
 		voltage = (uint32_t)(adc1_get_raw(ADC1_CHANNEL_7) * 1.76f);
 		vTaskDelay(1);
 		ui_isr_enable();
+		TRACE_BEGIN(TRACE_ID_OLED);
+#if LED_NUM_ZONES > 1
+		char zone[5] = "all";
+		if (ui_zone < LED_NUM_ZONES) {
+			snprintf(zone, sizeof(zone), "z%u", ui_zone + 1);
+		}
+		snprintf(status, sizeof(status), "%3u%% %-4s %4umV", led_get_intensity(), zone, voltage);
+#else
 		snprintf(status, sizeof(status), "%3u%%      %4umV", led_get_intensity(), voltage);
+#endif
 		ssd1306_display_text(dev, 0, status, 16, true);
 		snprintf(hue_str, sizeof(hue_str), "1:%3u      2:%3u", led_get_primary_hue(), led_get_secondary_hue());
 		ssd1306_display_text(dev, 1, hue_str, 16, true);
+#if CONFIG_LED_CURRENT_LIMIT
+		snprintf(bpm_str, sizeof(bpm_str), "%5ubpm %5umA", (uint32_t)(60000 / led_get_period()), led_get_current_ma());
+#else
 		snprintf(bpm_str, sizeof(bpm_str), "%5ubpm        ", (uint32_t)(60000 / led_get_period()));
+#endif
 		ssd1306_display_text(dev, 7, bpm_str, 16, true);
+		TRACE_END(TRACE_ID_OLED);
 
 		switch (state) {
 		case UI_STATE_IDLE:
 			ssd1306_display_text(dev, 3, "     color", 11, false);
 			ssd1306_display_text(dev, 4, "   pat + tempo", 14, false);
 			ssd1306_display_text(dev, 5, "     intens.", 12, false);
+			ssd1306_display_text(dev, 6, "   +: palette", 13, false);
 			switch (buttons) {
 			case UI_BTN_NONE:
 				idle_timer += UI_LOOP_PERIOD;
@@ -182,6 +221,11 @@ void ui_loop(void* parameters)
 				ssd1306_clear_screen(dev, false);
 				ui_change_state(UI_STATE_INTENSITY);
 				break;
+			case UI_BTN_PRS:
+				idle_timer = 0;
+				ssd1306_clear_screen(dev, false);
+				ui_change_state(UI_STATE_PALETTE);
+				break;
 			default:
 				ESP_LOGW(TAG, "Unknown button %08x", buttons);
 				break;
@@ -220,7 +264,75 @@ void ui_loop(void* parameters)
 			case UI_BTN_PRS:
 				idle_timer = 0;
 				led_pattern_t* patterns = get_patterns();
+#if LED_NUM_ZONES > 1
+				if (ui_zone < LED_NUM_ZONES) {
+					led_set_layer(ui_zone, &patterns[selection], LED_BLEND_ALPHA, 255);
+				} else {
+					/* A new look for the whole strip starts without overlays */
+					led_set_pattern(&patterns[selection]);
+					for (uint8_t layer = LED_NUM_ZONES; layer < LED_NUM_LAYERS; layer++) {
+						led_set_layer(layer, NULL, LED_BLEND_ALPHA, 255);
+					}
+				}
+#else
 				led_set_pattern(&patterns[selection]);
+#endif
+				cur_menu = NULL;
+				ui_change_state(UI_STATE_IDLE);
+				ssd1306_clear_screen(dev, false);
+				break;
+			case UI_BTN_R:
+			{
+				/* Stack the pattern on top of the others, reusing the top layer when full */
+				uint8_t layer = LED_NUM_ZONES;
+				idle_timer = 0;
+				while (layer < (LED_NUM_LAYERS - 1) && led_get_layer(layer)) {
+					layer++;
+				}
+				led_set_layer(layer, &get_patterns()[selection], LED_BLEND_SCREEN, 255);
+				cur_menu = NULL;
+				ui_change_state(UI_STATE_IDLE);
+				ssd1306_clear_screen(dev, false);
+				break;
+			}
+			case UI_BTN_L:
+				idle_timer = 0;
+#if LED_NUM_ZONES > 1
+				/* Step through the zones, then all of them */
+				ui_zone = (ui_zone + 1) % (LED_NUM_ZONES + 1);
+#else
+				for (uint8_t layer = LED_NUM_ZONES; layer < LED_NUM_LAYERS; layer++) {
+					led_set_layer(layer, NULL, LED_BLEND_ALPHA, 255);
+				}
+#endif
+				break;
+			default:
+				ESP_LOGW(TAG, "Unknown button %08x", buttons);
+				break;
+			}
+			break;
+		}
+		case UI_STATE_PALETTE:
+		{
+			uint8_t selection = ui_show_menu(dev, get_palette_menu(), PALETTE_NUM_GRADIENTS, 0);
+			switch (buttons) {
+			case UI_BTN_NONE:
+				if (ui_idle_service(&idle_timer)) {
+					ssd1306_clear_screen(dev, false);
+					cur_menu = NULL;
+				}
+				break;
+			case UI_BTN_UP:
+				idle_timer = 0;
+				ui_show_menu(dev, get_palette_menu(), PALETTE_NUM_GRADIENTS, -1);
+				break;
+			case UI_BTN_DN:
+				idle_timer = 0;
+				ui_show_menu(dev, get_palette_menu(), PALETTE_NUM_GRADIENTS, 1);
+				break;
+			case UI_BTN_PRS:
+				idle_timer = 0;
+				led_set_palette(selection);
 				cur_menu = NULL;
 				ui_change_state(UI_STATE_IDLE);
 				ssd1306_clear_screen(dev, false);
@@ -326,7 +438,7 @@ void ui_loop(void* parameters)
 					ssd1306_clear_screen(dev, false);
 					ui_buttons_reg_callback(ui_btn_callback);
 					if (avg_samples) {
-						led_set_period(cur_avg / avg_samples);
+						led_set_period_us(cur_avg * 1000 / avg_samples);
 					}
 					ui_btn_tempo_callback(UI_BTN_NONE);
 				}
@@ -362,6 +474,11 @@ void ui_loop(void* parameters)
 		}
 
 		xTaskNotifyWait(0, UINT32_MAX, &buttons, pdMS_TO_TICKS(UI_LOOP_PERIOD));
+#if CONFIG_LED_LATENCY
+		if (buttons) {
+			LATENCY_MARK(LATENCY_UI);
+		}
+#endif
 	}
 
 	vTaskDelete(NULL);
@@ -369,7 +486,6 @@ void ui_loop(void* parameters)
 
 void ui_init(void)
 {
-	SSD1306_t dev;
 #if CONFIG_I2C_INTERFACE
 	ESP_LOGI(TAG, "INTERFACE is i2c");
 	ESP_LOGI(TAG, "CONFIG_SDA_GPIO=%d",CONFIG_SDA_GPIO);
@@ -378,11 +494,11 @@ void ui_init(void)
 	i2c_master_init(CONFIG_SDA_GPIO, CONFIG_SCL_GPIO, CONFIG_RESET_GPIO);
 #if CONFIG_SSD1306_128x64
 	ESP_LOGI(TAG, "Panel is 128x64");
-	i2c_init(&dev, 128, 64, 0x3C);
+	i2c_init(&oled, 128, 64, 0x3C);
 #endif // CONFIG_SSD1306_128x64
 #if CONFIG_SSD1306_128x32
 	ESP_LOGI(TAG, "Panel is 128x32");
-	i2c_init(&dev, 128, 32, 0x3C);
+	i2c_init(&oled, 128, 32, 0x3C);
 #endif // CONFIG_SSD1306_128x32
 #endif // CONFIG_I2C_INTERFACE
 
@@ -391,11 +507,11 @@ void ui_init(void)
 	ESP_LOGI(TAG, "CONFIG_CS_GPIO=%d",CONFIG_CS_GPIO);
 	ESP_LOGI(TAG, "CONFIG_DC_GPIO=%d",CONFIG_DC_GPIO);
 	ESP_LOGI(TAG, "CONFIG_RESET_GPIO=%d",CONFIG_RESET_GPIO);
-	spi_master_init(&dev, CONFIG_CS_GPIO, CONFIG_DC_GPIO, CONFIG_RESET_GPIO);
-	spi_init(&dev, 128, 64);
+	spi_master_init(&oled, CONFIG_CS_GPIO, CONFIG_DC_GPIO, CONFIG_RESET_GPIO);
+	spi_init(&oled, 128, 64);
 #endif // CONFIG_SPI_INTERFACE
 
-	xTaskCreatePinnedToCore(ui_loop, "UI loop", 4096, &dev, 2, &ui_task, 0);
+	SYSMON_TASK_CREATE(ui_loop, "UI loop", UI_TASK_STACK, &oled, 2, &ui_task, 0);
 
 	/* Initialize button ISR and debouncer */
 	ui_buttons_init();
@@ -3,14 +3,49 @@
 #include "driver/gpio.h"
 #include "esp_log.h"
 
+#include "hal/gpio_ll.h"
 #include "hal/gpio_types.h"
+#include "latency.h"
+#include "sysmon.h"
+#include "trace.h"
 #include "ui.h"
 #include "ui_buttons.h"
 
 #define TAG "UI_btn"
+#define UI_BUTTONS_TASK_STACK	1024
+#define UI_BUTTONS_POLL_MS	20
+
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+/*
+ * Only level interrupts wake the chip from light sleep. Each one disarms its
+ * button so it doesn't fire again and again, until the debounce task has
+ * seen the button let go.
+ */
+#define UI_BUTTONS_INTR		GPIO_INTR_LOW_LEVEL
+#define UI_BUTTON_DISARM(gpio)	gpio_ll_intr_disable(&GPIO, gpio)
+
+static const struct {
+	gpio_num_t gpio;
+	uint32_t bit;
+} ui_buttons[] = {
+	{ GPIO_NUM_32, UI_BTN_R },
+	{ GPIO_NUM_33, UI_BTN_L },
+	{ GPIO_NUM_34, UI_BTN_UP },
+	{ GPIO_NUM_36, UI_BTN_DN },
+	{ GPIO_NUM_39, UI_BTN_PRS },
+};
+#else
+#define UI_BUTTONS_INTR		GPIO_INTR_NEGEDGE
+#define UI_BUTTON_DISARM(gpio)
+#endif
 
 static void (*ui_buttons_callback)(uint32_t);
 static TaskHandle_t ui_buttons_task;
+#if CONFIG_LED_LATENCY
+/* Injected presses read as held down when they are debounced */
+static uint32_t buttons_injected;
+static portMUX_TYPE inject_mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
 
 void ui_isr_disable()
 {
@@ -20,9 +55,33 @@ void ui_isr_disable()
 
 void ui_isr_enable()
 {
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+	/* A button held down stays disarmed for the debounce task to arm */
+	if (gpio_get_level(GPIO_NUM_36)) {
+		gpio_intr_enable(GPIO_NUM_36);
+	}
+	if (gpio_get_level(GPIO_NUM_39)) {
+		gpio_intr_enable(GPIO_NUM_39);
+	}
+#else
 	gpio_intr_enable(GPIO_NUM_36);
 	gpio_intr_enable(GPIO_NUM_39);
+#endif
+}
+
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+/* Arm the disarmed buttons that have been let go, returns the ones still held */
+static uint32_t ui_buttons_rearm(uint32_t disarmed)
+{
+	for (uint8_t i = 0; i < sizeof(ui_buttons) / sizeof(ui_buttons[0]); i++) {
+		if ((disarmed & ui_buttons[i].bit) && gpio_get_level(ui_buttons[i].gpio)) {
+			gpio_intr_enable(ui_buttons[i].gpio);
+			disarmed &= ~ui_buttons[i].bit;
+		}
+	}
+	return disarmed;
 }
+#endif
 
 void ui_buttons_reg_callback(void (*cb)(uint32_t data))
 {
@@ -31,10 +90,21 @@ void ui_buttons_reg_callback(void (*cb)(uint32_t data))
 
 void ui_buttons_debounce_task(void* parameters)
 {
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+	uint32_t disarmed = 0;
+#endif
 	while (true) {
 		uint32_t button_bits = 0;
 		uint32_t buttons_debounced = 0;
-		xTaskNotifyWait(0, UINT32_MAX, &button_bits, portMAX_DELAY);
+		TickType_t wait = portMAX_DELAY;
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+		/* Poll while any button is held, the others still get through in the meantime */
+		disarmed = ui_buttons_rearm(disarmed);
+		wait = disarmed ? pdMS_TO_TICKS(UI_BUTTONS_POLL_MS) : portMAX_DELAY;
+#endif
+		if (xTaskNotifyWait(0, UINT32_MAX, &button_bits, wait) != pdTRUE) {
+			continue;
+		}
 		vTaskDelay(pdMS_TO_TICKS(50));
 		if (!gpio_get_level(GPIO_NUM_32)) {
 			buttons_debounced |= button_bits & UI_BTN_R;
@@ -51,39 +121,81 @@ void ui_buttons_debounce_task(void* parameters)
 		if (!gpio_get_level(GPIO_NUM_39)) {
 			buttons_debounced |= button_bits & UI_BTN_PRS;
 		}
+#if CONFIG_LED_LATENCY
+		portENTER_CRITICAL(&inject_mux);
+		buttons_debounced |= button_bits & buttons_injected;
+		buttons_injected &= ~button_bits;
+		portEXIT_CRITICAL(&inject_mux);
+#endif
 		if (buttons_debounced && ui_buttons_callback) {
+			LATENCY_MARK(LATENCY_DEBOUNCED);
 			ui_buttons_callback(buttons_debounced);
 			ESP_LOGD(TAG, "buttons debounced %08x", buttons_debounced);
 		}
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+		disarmed |= button_bits;
+#endif
 	}
 }
 
 void IRAM_ATTR ui_button_r(void* arg)
 {
 	TaskHandle_t* buttons_task = (TaskHandle_t*)arg;
+	TRACE_ISR_ENTER(TRACE_ID_GPIO_ISR);
+	LATENCY_MARK(LATENCY_PRESS);
+	UI_BUTTON_DISARM(GPIO_NUM_32);
 	xTaskNotifyFromISR(*buttons_task, UI_BTN_R, eSetBits, NULL);
+	TRACE_ISR_EXIT(TRACE_ID_GPIO_ISR);
 }
 void IRAM_ATTR ui_button_l(void* arg)
 {
 	TaskHandle_t* buttons_task = (TaskHandle_t*)arg;
+	TRACE_ISR_ENTER(TRACE_ID_GPIO_ISR);
+	LATENCY_MARK(LATENCY_PRESS);
+	UI_BUTTON_DISARM(GPIO_NUM_33);
 	xTaskNotifyFromISR(*buttons_task, UI_BTN_L, eSetBits, NULL);
+	TRACE_ISR_EXIT(TRACE_ID_GPIO_ISR);
 }
 void IRAM_ATTR ui_button_up(void* arg)
 {
 	TaskHandle_t* buttons_task = (TaskHandle_t*)arg;
+	TRACE_ISR_ENTER(TRACE_ID_GPIO_ISR);
+	LATENCY_MARK(LATENCY_PRESS);
+	UI_BUTTON_DISARM(GPIO_NUM_34);
 	xTaskNotifyFromISR(*buttons_task, UI_BTN_UP, eSetBits, NULL);
+	TRACE_ISR_EXIT(TRACE_ID_GPIO_ISR);
 }
 void IRAM_ATTR ui_button_dn(void* arg)
 {
 	TaskHandle_t* buttons_task = (TaskHandle_t*)arg;
+	TRACE_ISR_ENTER(TRACE_ID_GPIO_ISR);
+	LATENCY_MARK(LATENCY_PRESS);
+	UI_BUTTON_DISARM(GPIO_NUM_36);
 	xTaskNotifyFromISR(*buttons_task, UI_BTN_DN, eSetBits, NULL);
+	TRACE_ISR_EXIT(TRACE_ID_GPIO_ISR);
 }
 void IRAM_ATTR ui_button_prs(void* arg)
 {
 	TaskHandle_t* buttons_task = (TaskHandle_t*)arg;
+	TRACE_ISR_ENTER(TRACE_ID_GPIO_ISR);
+	LATENCY_MARK(LATENCY_PRESS);
+	UI_BUTTON_DISARM(GPIO_NUM_39);
 	xTaskNotifyFromISR(*buttons_task, UI_BTN_PRS, eSetBits, NULL);
+	TRACE_ISR_EXIT(TRACE_ID_GPIO_ISR);
 }
 
+#if CONFIG_LED_LATENCY
+/* Press buttons from a task as if the interrupts had, to time the path to the LEDs */
+void ui_buttons_inject(uint32_t buttons)
+{
+	LATENCY_MARK(LATENCY_PRESS);
+	portENTER_CRITICAL(&inject_mux);
+	buttons_injected |= buttons;
+	portEXIT_CRITICAL(&inject_mux);
+	xTaskNotify(ui_buttons_task, buttons, eSetBits);
+}
+#endif
+
 void ui_buttons_init()
 {
 	/* Button configuration */
@@ -93,10 +205,15 @@ void ui_buttons_init()
 		GPIO_MODE_INPUT,
 		GPIO_PULLUP_ENABLE,
 		GPIO_PULLDOWN_DISABLE,
-		GPIO_INTR_NEGEDGE };
+		UI_BUTTONS_INTR };
 	gpio_config(&gpio_conf);
+#if CONFIG_LED_POWER_LIGHT_SLEEP
+	for (uint8_t i = 0; i < sizeof(ui_buttons) / sizeof(ui_buttons[0]); i++) {
+		gpio_wakeup_enable(ui_buttons[i].gpio, GPIO_INTR_LOW_LEVEL);
+	}
+#endif
 
-	xTaskCreatePinnedToCore(ui_buttons_debounce_task, "UI debounce", 1024, NULL, 2, &ui_buttons_task, 0);
+	SYSMON_TASK_CREATE(ui_buttons_debounce_task, "UI debounce", UI_BUTTONS_TASK_STACK, NULL, 2, &ui_buttons_task, 0);
 
 	/* Interrupt configuration */
 	gpio_install_isr_service(0);
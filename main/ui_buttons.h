@@ -18,6 +18,7 @@ void ui_isr_enable(void);
 
 void ui_buttons_reg_callback(void (*cb)(uint32_t data));
 
+void ui_buttons_inject(uint32_t buttons);
 void ui_buttons_init(void);
 
 #endif /* UI_BUTTONS_H */
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Drive a tubalux unit over its WebSocket control API and measure latency.
+
+Join the unit's access point (CONFIG_LED_CONTROL), then e.g.
+    tools/control_client.py 192.168.4.1 --count 200
+sweeps the hue and prints percentiles of the round trip seen here and of the
+time from the message arriving to the frame with the change on the strip,
+as reported by the unit. Single commands can be sent too:
+    tools/control_client.py 192.168.4.1 --set pattern=Plasma --set layer=1
+
+See main/control.h for the messages.
+"""
+import argparse
+import base64
+import json
+import os
+import socket
+import struct
+import sys
+import time
+
+OP_TEXT = 0x1
+OP_CLOSE = 0x8
+OP_PING = 0x9
+
+
+class WebSocket:
+    """Just enough of RFC 6455 for text messages"""
+
+    def __init__(self, host, port, path):
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.sock.sendall((
+            f'GET {path} HTTP/1.1\r\n'
+            f'Host: {host}:{port}\r\n'
+            'Upgrade: websocket\r\n'
+            'Connection: Upgrade\r\n'
+            f'Sec-WebSocket-Key: {key}\r\n'
+            'Sec-WebSocket-Version: 13\r\n\r\n').encode())
+        response = b''
+        while b'\r\n\r\n' not in response:
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                raise ConnectionError('connection closed during handshake')
+            response += chunk
+        head, self.buf = response.split(b'\r\n\r\n', 1)
+        if b' 101 ' not in head.split(b'\r\n')[0]:
+            raise ConnectionError(head.split(b'\r\n')[0].decode())
+
+    def _read(self, n):
+        while len(self.buf) < n:
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError('connection closed')
+            self.buf += chunk
+        data, self.buf = self.buf[:n], self.buf[n:]
+        return data
+
+    def send(self, opcode, payload):
+        # Clients must mask everything they send
+        mask = os.urandom(4)
+        header = bytes([0x80 | opcode])
+        if len(payload) < 126:
+            header += bytes([0x80 | len(payload)])
+        elif len(payload) < 1 << 16:
+            header += struct.pack('>BH', 0x80 | 126, len(payload))
+        else:
+            header += struct.pack('>BQ', 0x80 | 127, len(payload))
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(header + mask + masked)
+
+    def send_json(self, msg):
+        self.send(OP_TEXT, json.dumps(msg).encode())
+
+    def recv_json(self):
+        while True:
+            b0, b1 = self._read(2)
+            length = b1 & 0x7f
+            if length == 126:
+                length, = struct.unpack('>H', self._read(2))
+            elif length == 127:
+                length, = struct.unpack('>Q', self._read(8))
+            payload = self._read(length)
+            opcode = b0 & 0x0f
+            if opcode == OP_TEXT:
+                return json.loads(payload)
+            if opcode == OP_PING:
+                self.send(0xA, payload)
+            elif opcode == OP_CLOSE:
+                raise ConnectionError('closed by unit')
+
+
+def parse_value(value):
+    try:
+        return int(value)
+    except ValueError:
+        return value
+
+
+def percentiles(samples):
+    samples = sorted(samples)
+    pick = lambda p: samples[min(len(samples) - 1, int(p * len(samples)))]
+    return f'p50 {pick(0.5):.2f} p90 {pick(0.9):.2f} p99 {pick(0.99):.2f} max {samples[-1]:.2f} ms'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host', help='unit address, 192.168.4.1 on its own access point')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--count', type=int, default=100, help='hue changes to time')
+    parser.add_argument('--interval', type=float, default=0.02, help='seconds between changes')
+    parser.add_argument('--set', action='append', default=[], metavar='KEY=VALUE',
+                        help='send one command instead of timing, can be repeated')
+    args = parser.parse_args()
+
+    ws = WebSocket(args.host, args.port, '/ws')
+    state = ws.recv_json()
+    print(f'{len(state.get("patterns", []))} patterns, {state["fps"]} fps, {state["heap"]} bytes free')
+
+    if args.set:
+        msg = {'id': 1}
+        for item in args.set:
+            key, _, value = item.partition('=')
+            msg[key] = parse_value(value)
+        ws.send_json(msg)
+        while True:
+            reply = ws.recv_json()
+            if reply.get('ack') == 1 or reply.get('id') == 1:
+                print(reply)
+                return 0 if 'ack' in reply else 1
+
+    rtt = []
+    latency = []
+    errors = 0
+    for i in range(1, args.count + 1):
+        sent = time.perf_counter()
+        ws.send_json({'id': i, 'hue': i * 7 % 360})
+        while True:
+            reply = ws.recv_json()
+            if reply.get('ack') == i:
+                rtt.append((time.perf_counter() - sent) * 1000)
+                latency.append(reply['latency_us'] / 1000)
+                break
+            if reply.get('id') == i and 'error' in reply:
+                errors += 1
+                break
+        time.sleep(args.interval)
+
+    if rtt:
+        print(f'round trip:      {percentiles(rtt)}')
+        print(f'message to strip: {percentiles(latency)}')
+    print(f'{len(rtt)} acked, {errors} not applied')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
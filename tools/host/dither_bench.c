@@ -0,0 +1,93 @@
+/*
+ * Host benchmark for the CONFIG_LED_DITHER output pass, by default on a
+ * strip of 300 LEDs. From tools/host:
+ *     make dither_bench
+ *     ./dither_bench [leds]
+ * Besides the timings it checks that a dim gradient averages out to its
+ * 16-bit values over 256 refreshes.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "led_dither.h"
+
+#define BENCH_FRAMES	2000
+#define BENCH_AVERAGE	256
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void report(const char* name, int64_t us, uint32_t num)
+{
+	double per_frame = (double)us / BENCH_FRAMES;
+	printf("%-10s %9.2f us/frame %7.2f ns/LED\n", name, per_frame, per_frame * 1000 / num);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t num = (argc > 1) ? atoi(argv[1]) : 300;
+	uint32_t len = num * 3;
+	uint8_t* src = malloc(len);
+	uint8_t* dst = malloc(len);
+	uint8_t* err = malloc(len);
+	uint16_t* deep = malloc(len * sizeof(uint16_t));
+	uint32_t* total = calloc(len, sizeof(uint32_t));
+	uint32_t sum = 0;
+	if (!num || !src || !dst || !err || !deep || !total) {
+		fprintf(stderr, "can't bench %u LEDs\n", num);
+		return 1;
+	}
+	for (uint32_t i = 0; i < len; i++) {
+		src[i] = i * 7;
+	}
+	led_dither_seed(err, len);
+	printf("%u LEDs\n", num);
+
+	int64_t start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		led_dither_expand(deep, src, len);
+		sum += deep[f % len];
+	}
+	report("expand", now_us() - start, num);
+
+	start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		sum += led_dither_quantise(dst, deep, err, len, LED_DITHER_LEVEL_MAX);
+		sum += dst[f % len];
+	}
+	report("full", now_us() - start, num);
+
+	start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		sum += led_dither_quantise(dst, deep, err, len, LED_DITHER_LEVEL_MAX * 3 / 100);
+		sum += dst[f % len];
+	}
+	report("dim", now_us() - start, num);
+
+	/* Every 16-bit level from 0 to 2 in 8-bit steps, in 1/256 steps */
+	for (uint32_t i = 0; i < len; i++) {
+		deep[i] = i % 512;
+	}
+	for (uint32_t f = 0; f < BENCH_AVERAGE; f++) {
+		led_dither_quantise(dst, deep, err, len, LED_DITHER_LEVEL_MAX);
+		for (uint32_t i = 0; i < len; i++) {
+			total[i] += dst[i];
+		}
+	}
+	uint32_t worst = 0;
+	for (uint32_t i = 0; i < len; i++) {
+		/* total / 256 should be deep / 256, give or take one refresh's worth */
+		uint32_t off = (total[i] > deep[i]) ? total[i] - deep[i] : deep[i] - total[i];
+		worst = (off > worst) ? off : worst;
+	}
+	printf("average over %u refreshes off by at most %u/256 of a level\n", BENCH_AVERAGE, worst);
+
+	/* Keeps the loops from being optimised away */
+	return (sum == 1 || worst > 1) ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Host test and benchmark for the fixed point primitives. Each one is
+ * checked against the exact value worked out in double, over every input
+ * where that is feasible and a spread of them otherwise, then timed the way
+ * fixed_benchmark() does on the ESP32. From tools/host:
+ *     make fixed_test
+ *     ./fixed_test
+ * or make check, which runs every test. Exits non-zero if any result is
+ * further off than its limit.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "fixed.h"
+
+#define BENCH_ITERATIONS	(1 << 24)
+/* Inputs to the 16-bit functions are stepped by this, odd so both odd and even ones come up */
+#define TEST_STRIDE16		251
+
+typedef struct {
+	const char* name;
+	double worst;		/* furthest from the exact value */
+	uint32_t wrong;		/* results that broke an exact rule */
+} test_t;
+
+static uint32_t failed = 0;
+
+static void test_off(test_t* t, double got, double exact)
+{
+	double off = fabs(got - exact);
+	t->worst = (off > t->worst) ? off : t->worst;
+}
+
+static void test_report(const test_t* t, double limit)
+{
+	bool ok = t->worst <= limit && !t->wrong;
+	printf("%-10s %s, at most %.3f off (limit %.1f)", t->name, ok ? "ok" : "FAIL", t->worst, limit);
+	if (t->wrong) {
+		printf(", %u broke an exact rule", t->wrong);
+	}
+	printf("\n");
+	failed += !ok;
+}
+
+static void test_scale8(void)
+{
+	test_t t = { .name = "scale8" };
+	for (uint32_t x = 0; x < 256; x++) {
+		for (uint32_t s = 0; s < 256; s++) {
+			uint8_t y = scale8(x, s);
+			test_off(&t, y, x * s / 255.0);
+			/* 255 is the whole of it and 0 is none of it */
+			t.wrong += (s == 255 && y != x) || (s == 0 && y != 0);
+		}
+	}
+	test_report(&t, 1);
+}
+
+static void test_scale16(void)
+{
+	test_t t = { .name = "scale16" };
+	for (uint32_t x = 0; x < 65536; x += TEST_STRIDE16) {
+		for (uint32_t s = 0; s < 65536; s += TEST_STRIDE16) {
+			test_off(&t, scale16(x, s), (double)x * s / 65535.0);
+		}
+		t.wrong += scale16(x, 65535) != x || scale16(x, 0) != 0;
+	}
+	test_report(&t, 1);
+}
+
+static void test_lerp8(void)
+{
+	test_t t = { .name = "lerp8" };
+	for (uint32_t a = 0; a < 256; a++) {
+		for (uint32_t b = 0; b < 256; b++) {
+			for (uint32_t f = 0; f < 256; f++) {
+				test_off(&t, lerp8(a, b, f), a + ((double)b - a) * f / 255.0);
+			}
+			t.wrong += lerp8(a, b, 0) != a || lerp8(a, b, 255) != b;
+		}
+	}
+	test_report(&t, 1);
+}
+
+static void test_lerp16(void)
+{
+	test_t t = { .name = "lerp16" };
+	for (uint32_t a = 0; a < 65536; a += TEST_STRIDE16) {
+		for (uint32_t b = 0; b < 65536; b += TEST_STRIDE16) {
+			for (uint32_t f = 0; f < 65536; f += 4099) {
+				test_off(&t, lerp16(a, b, f), a + ((double)b - a) * f / 65535.0);
+			}
+			t.wrong += lerp16(a, b, 0) != a || lerp16(a, b, 65535) != b;
+		}
+	}
+	test_report(&t, 1);
+}
+
+static void test_sin8(void)
+{
+	test_t t = { .name = "sin8" };
+	for (uint32_t theta = 0; theta < 256; theta++) {
+		double exact = 128 + 127.5 * sin(theta * 2 * M_PI / 256);
+		test_off(&t, sin8(theta), exact);
+		/* Rounded down, so never above */
+		t.wrong += sin8(theta) > exact;
+		t.wrong += cos8(theta) != sin8(theta + 64);
+	}
+	test_report(&t, 1);
+}
+
+static void test_sin16(void)
+{
+	test_t t = { .name = "sin16" };
+	for (uint32_t theta = 0; theta < 65536; theta++) {
+		test_off(&t, sin16(theta), 32767 * sin(theta * 2 * M_PI / 65536));
+		/* Odd and symmetric about the quarter turns */
+		t.wrong += sin16(theta) != -sin16(-theta) && theta != 0x8000;
+		t.wrong += cos16(theta) != sin16(theta + 0x4000);
+	}
+	test_report(&t, 2);
+}
+
+static void test_saturating(void)
+{
+	test_t add8 = { .name = "qadd8" };
+	test_t sub8 = { .name = "qsub8" };
+	for (uint32_t a = 0; a < 256; a++) {
+		for (uint32_t b = 0; b < 256; b++) {
+			add8.wrong += qadd8(a, b) != ((a + b > 255) ? 255 : a + b);
+			sub8.wrong += qsub8(a, b) != ((a > b) ? a - b : 0);
+		}
+	}
+	test_report(&add8, 0);
+	test_report(&sub8, 0);
+
+	test_t add16 = { .name = "qadd16" };
+	test_t sub16 = { .name = "qsub16" };
+	for (uint32_t a = 0; a < 65536; a += TEST_STRIDE16) {
+		for (uint32_t b = 0; b < 65536; b += TEST_STRIDE16) {
+			add16.wrong += qadd16(a, b) != ((a + b > 65535) ? 65535 : a + b);
+			sub16.wrong += qsub16(a, b) != ((a > b) ? a - b : 0);
+		}
+		add16.wrong += qadd16(a, 65535) != 65535 || qsub16(a, 65535) != 0;
+	}
+	test_report(&add16, 0);
+	test_report(&sub16, 0);
+}
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* The sink keeps the compiler from dropping the loops */
+static volatile uint32_t sink;
+
+#define TEST_BENCH(name, expr) do {						\
+	uint32_t acc = 0;							\
+	int64_t start = now_ns();						\
+	for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {			\
+		acc += (expr);							\
+	}									\
+	int64_t ns = now_ns() - start;						\
+	sink = acc;								\
+	printf("%-20s %6.2f ns\n", name, (double)ns / BENCH_ITERATIONS);	\
+} while (0)
+
+/* Time per call of each primitive, loop overhead included */
+static void test_bench(void)
+{
+	TEST_BENCH("loop", i);
+	TEST_BENCH("scale8", scale8(i, i >> 4));
+	TEST_BENCH("scale16", scale16(i * 17, i * 13));
+	TEST_BENCH("qadd8", qadd8(i, i >> 3));
+	TEST_BENCH("qsub8", qsub8(i, i >> 3));
+	TEST_BENCH("lerp8", lerp8(i, i >> 4, i >> 2));
+	TEST_BENCH("lerp16", lerp16(i * 17, i * 5, i * 13));
+	TEST_BENCH("sin8", sin8(i));
+	TEST_BENCH("sin16", sin16(i * 16));
+}
+
+int main(void)
+{
+	test_scale8();
+	test_scale16();
+	test_lerp8();
+	test_lerp16();
+	test_sin8();
+	test_sin16();
+	test_saturating();
+	test_bench();
+	return failed ? 1 : 0;
+}
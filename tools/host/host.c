@@ -0,0 +1,596 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "led_strip.h"
+
+#include "host.h"
+
+/*
+ * The FreeRTOS and ESP-IDF calls main/ makes, on POSIX threads and the
+ * monotonic clock, and an LED strip that hands its frames to the tool.
+ */
+
+struct host_task {
+	pthread_t thread;
+	const char* name;
+	TaskFunction_t fn;
+	void* parameters;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t notified;
+	bool pending;		/* notified since the last take or wait, whatever the value */
+};
+
+struct host_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint8_t* items;
+	UBaseType_t len;
+	UBaseType_t item_size;
+	UBaseType_t head;
+	UBaseType_t count;
+};
+
+struct esp_timer {
+	esp_timer_create_args_t args;
+	int64_t alarm;		/* on the unit's clock, INT64_MAX when stopped */
+	uint64_t period;
+	struct esp_timer* next;
+};
+
+typedef struct {
+	led_strip_t parent;
+	uint32_t num;
+	uint8_t* rgb;
+} host_strip_t;
+
+static int64_t start_ns;
+static int64_t clock_offset = 0;
+static int32_t clock_ppm = 0;
+static __thread TaskHandle_t current = NULL;
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_cond;
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static struct esp_timer* timers = NULL;
+static void (*refresh_fn)(const uint8_t* rgb, uint32_t num, void* arg) = NULL;
+static void* refresh_arg;
+
+static int64_t host_monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+__attribute__((constructor)) static void host_start(void)
+{
+	start_ns = host_monotonic_ns();
+}
+
+static struct timespec host_timespec(int64_t ns)
+{
+	return (struct timespec) { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+}
+
+/* When the machine's clock reaches time on the unit's */
+static struct timespec host_deadline(int64_t time)
+{
+	int64_t real = (time - clock_offset) * 1000000 / (1000000 + clock_ppm);
+	return host_timespec(start_ns + real * 1000);
+}
+
+static struct timespec host_after_ticks(TickType_t ticks)
+{
+	return host_timespec(host_monotonic_ns() + (int64_t)ticks * portTICK_PERIOD_MS * 1000000);
+}
+
+/* Waits are on the monotonic clock, so they time out the same whatever the clock is set to */
+static void host_cond_init(pthread_cond_t* cond)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+/* Returns false if ticks ran out first */
+static bool host_wait(pthread_cond_t* cond, pthread_mutex_t* lock, const struct timespec* until, TickType_t ticks)
+{
+	if (ticks == portMAX_DELAY) {
+		pthread_cond_wait(cond, lock);
+		return true;
+	}
+	return pthread_cond_timedwait(cond, lock, until) != ETIMEDOUT;
+}
+
+int64_t host_real_time(void)
+{
+	return (host_monotonic_ns() - start_ns) / 1000;
+}
+
+void host_set_clock(int64_t offset_us, int32_t ppm)
+{
+	clock_offset = offset_us;
+	clock_ppm = ppm;
+}
+
+void host_strip_on_refresh(void (*fn)(const uint8_t* rgb, uint32_t num, void* arg), void* arg)
+{
+	refresh_fn = fn;
+	refresh_arg = arg;
+}
+
+static TaskHandle_t host_task_new(const char* name)
+{
+	TaskHandle_t task = calloc(1, sizeof(struct host_task));
+	if (!task) {
+		return NULL;
+	}
+	task->name = name;
+	pthread_mutex_init(&task->lock, NULL);
+	host_cond_init(&task->cond);
+	return task;
+}
+
+static void* host_task_run(void* arg)
+{
+	current = arg;
+	current->fn(current->parameters);
+	return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* parameters,
+				   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+	TaskHandle_t task = host_task_new(name);
+	if (!task) {
+		return pdFAIL;
+	}
+	task->fn = fn;
+	task->parameters = parameters;
+	if (handle) {
+		*handle = task;
+	}
+	if (pthread_create(&task->thread, NULL, host_task_run, task)) {
+		free(task);
+		return pdFAIL;
+	}
+	pthread_detach(task->thread);
+	return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack,
+					   void* parameters, UBaseType_t priority, StackType_t* stack_buf,
+					   StaticTask_t* task_buf, BaseType_t core)
+{
+	TaskHandle_t task = NULL;
+	xTaskCreatePinnedToCore(fn, name, stack, parameters, priority, &task, core);
+	return task;
+}
+
+/* Handles are never freed, so they stay safe to look at like they aren't on the ESP32 */
+void vTaskDelete(TaskHandle_t task)
+{
+	if (!task || task == current) {
+		pthread_exit(NULL);
+	}
+	pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	struct timespec until = host_after_ticks(ticks);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return esp_timer_get_time() / (portTICK_PERIOD_MS * 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	/* The thread running main() becomes a task the first time it asks */
+	if (!current) {
+		current = host_task_new("main");
+		current->thread = pthread_self();
+	}
+	return current;
+}
+
+const char* pcTaskGetTaskName(TaskHandle_t task)
+{
+	return task ? task->name : xTaskGetCurrentTaskHandle()->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+	return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	return xTaskNotify(task, 0, eIncrement);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	struct timespec until = host_after_ticks(ticks);
+	pthread_mutex_lock(&task->lock);
+	while (!task->notified && host_wait(&task->cond, &task->lock, &until, ticks));
+	uint32_t value = task->notified;
+	if (value) {
+		task->notified = clear ? 0 : value - 1;
+	}
+	task->pending = false;
+	pthread_mutex_unlock(&task->lock);
+	return value;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+	pthread_mutex_lock(&task->lock);
+	switch (action) {
+	case eSetBits:
+		task->notified |= value;
+		break;
+	case eIncrement:
+		task->notified++;
+		break;
+	case eSetValueWithOverwrite:
+		task->notified = value;
+		break;
+	default:
+		break;
+	}
+	task->pending = true;
+	pthread_cond_signal(&task->cond);
+	pthread_mutex_unlock(&task->lock);
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks)
+{
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	struct timespec until = host_after_ticks(ticks);
+	pthread_mutex_lock(&task->lock);
+	if (!task->pending) {
+		task->notified &= ~clear_on_entry;
+	}
+	while (!task->pending && host_wait(&task->cond, &task->lock, &until, ticks));
+	if (value) {
+		*value = task->notified;
+	}
+	BaseType_t got = task->pending ? pdTRUE : pdFALSE;
+	if (got) {
+		task->notified &= ~clear_on_exit;
+		task->pending = false;
+	}
+	pthread_mutex_unlock(&task->lock);
+	return got;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t len, UBaseType_t item_size, uint8_t* storage, StaticQueue_t* queue_buf)
+{
+	QueueHandle_t queue = calloc(1, sizeof(struct host_queue));
+	if (!queue) {
+		return NULL;
+	}
+	pthread_mutex_init(&queue->lock, NULL);
+	host_cond_init(&queue->cond);
+	queue->items = storage;
+	queue->len = len;
+	queue->item_size = item_size;
+	return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+	uint8_t* storage = malloc(len * item_size);
+	QueueHandle_t queue = storage ? xQueueCreateStatic(len, item_size, storage, NULL) : NULL;
+	if (!queue) {
+		free(storage);
+	}
+	return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+	struct timespec until = host_after_ticks(ticks);
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == queue->len && ticks && host_wait(&queue->cond, &queue->lock, &until, ticks));
+	bool room = queue->count < queue->len;
+	if (room) {
+		UBaseType_t tail = (queue->head + queue->count++) % queue->len;
+		memcpy(&queue->items[tail * queue->item_size], item, queue->item_size);
+		pthread_cond_broadcast(&queue->cond);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return room ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+	struct timespec until = host_after_ticks(ticks);
+	pthread_mutex_lock(&queue->lock);
+	while (!queue->count && ticks && host_wait(&queue->cond, &queue->lock, &until, ticks));
+	bool got = queue->count > 0;
+	if (got) {
+		memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+		queue->head = (queue->head + 1) % queue->len;
+		queue->count--;
+		pthread_cond_broadcast(&queue->cond);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return got ? pdTRUE : pdFALSE;
+}
+
+int64_t esp_timer_get_time(void)
+{
+	int64_t real = host_real_time();
+	return clock_offset + real + real * clock_ppm / 1000000;
+}
+
+/* Runs the callbacks one at a time, the earliest first */
+static void* host_timer_task(void* arg)
+{
+	pthread_mutex_lock(&timer_lock);
+	while (true) {
+		struct esp_timer* first = NULL;
+		for (struct esp_timer* t = timers; t; t = t->next) {
+			if (t->alarm != INT64_MAX && (!first || t->alarm < first->alarm)) {
+				first = t;
+			}
+		}
+		if (!first) {
+			pthread_cond_wait(&timer_cond, &timer_lock);
+			continue;
+		}
+		if (esp_timer_get_time() < first->alarm) {
+			struct timespec until = host_deadline(first->alarm);
+			pthread_cond_timedwait(&timer_cond, &timer_lock, &until);
+			continue;
+		}
+		first->alarm = first->period ? first->alarm + first->period : INT64_MAX;
+		pthread_mutex_unlock(&timer_lock);
+		first->args.callback(first->args.arg);
+		pthread_mutex_lock(&timer_lock);
+	}
+	return NULL;
+}
+
+static void host_timer_start(void)
+{
+	pthread_t thread;
+	host_cond_init(&timer_cond);
+	if (pthread_create(&thread, NULL, host_timer_task, NULL)) {
+		abort();
+	}
+	pthread_detach(thread);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle)
+{
+	if (!args || !args->callback || !handle) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	esp_timer_handle_t timer = calloc(1, sizeof(struct esp_timer));
+	if (!timer) {
+		return ESP_ERR_NO_MEM;
+	}
+	pthread_once(&timer_once, host_timer_start);
+	timer->args = *args;
+	timer->alarm = INT64_MAX;
+	pthread_mutex_lock(&timer_lock);
+	timer->next = timers;
+	timers = timer;
+	pthread_mutex_unlock(&timer_lock);
+	*handle = timer;
+	return ESP_OK;
+}
+
+static esp_err_t host_timer_arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period)
+{
+	pthread_mutex_lock(&timer_lock);
+	bool armed = timer->alarm != INT64_MAX;
+	if (!armed) {
+		timer->alarm = esp_timer_get_time() + timeout_us;
+		timer->period = period;
+		pthread_cond_signal(&timer_cond);
+	}
+	pthread_mutex_unlock(&timer_lock);
+	return armed ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+	return host_timer_arm(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+	return host_timer_arm(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+	pthread_mutex_lock(&timer_lock);
+	bool armed = timer->alarm != INT64_MAX;
+	timer->alarm = INT64_MAX;
+	pthread_mutex_unlock(&timer_lock);
+	return armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+	pthread_mutex_lock(&timer_lock);
+	for (struct esp_timer** t = &timers; *t; t = &(*t)->next) {
+		if (*t == timer) {
+			*t = timer->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&timer_lock);
+	free(timer);
+	return ESP_OK;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+	return esp_timer_get_time() / 1000;
+}
+
+/* Every process gets ids of its own, like every unit does */
+uint32_t esp_random(void)
+{
+	uint32_t r = 0;
+	while (getrandom(&r, sizeof(r), 0) != sizeof(r));
+	return r;
+}
+
+/* The ROM's is the zlib one */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len)
+{
+	crc = ~crc;
+	while (len--) {
+		crc ^= *buf++;
+		for (uint8_t k = 0; k < 8; k++) {
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+		}
+	}
+	return ~crc;
+}
+
+const char* esp_err_to_name(esp_err_t code)
+{
+	switch (code) {
+	case ESP_OK:
+		return "ESP_OK";
+	case ESP_FAIL:
+		return "ESP_FAIL";
+	case ESP_ERR_NO_MEM:
+		return "ESP_ERR_NO_MEM";
+	case ESP_ERR_INVALID_ARG:
+		return "ESP_ERR_INVALID_ARG";
+	case ESP_ERR_INVALID_STATE:
+		return "ESP_ERR_INVALID_STATE";
+	case ESP_ERR_INVALID_SIZE:
+		return "ESP_ERR_INVALID_SIZE";
+	case ESP_ERR_NOT_FOUND:
+		return "ESP_ERR_NOT_FOUND";
+	case ESP_ERR_NOT_SUPPORTED:
+		return "ESP_ERR_NOT_SUPPORTED";
+	case ESP_ERR_TIMEOUT:
+		return "ESP_ERR_TIMEOUT";
+	default:
+		return "ESP_ERR_UNKNOWN";
+	}
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+	return 0;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+	return 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+	return 0;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+						const char* label)
+{
+	return NULL;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+			     spi_flash_mmap_memory_t memory, const void** out_ptr, spi_flash_mmap_handle_t* out_handle)
+{
+	return ESP_ERR_NOT_FOUND;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle)
+{
+}
+
+static esp_err_t host_strip_set_pixel(led_strip_t* strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+	host_strip_t* s = __containerof(strip, host_strip_t, parent);
+	if (index >= s->num) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	s->rgb[index * 3 + 0] = red;
+	s->rgb[index * 3 + 1] = green;
+	s->rgb[index * 3 + 2] = blue;
+	return ESP_OK;
+}
+
+static esp_err_t host_strip_refresh(led_strip_t* strip, uint32_t timeout_ms)
+{
+	host_strip_t* s = __containerof(strip, host_strip_t, parent);
+	if (refresh_fn) {
+		refresh_fn(s->rgb, s->num, refresh_arg);
+	}
+	return ESP_OK;
+}
+
+static esp_err_t host_strip_clear(led_strip_t* strip, uint32_t timeout_ms)
+{
+	host_strip_t* s = __containerof(strip, host_strip_t, parent);
+	memset(s->rgb, 0, s->num * 3);
+	return host_strip_refresh(strip, timeout_ms);
+}
+
+static esp_err_t host_strip_del(led_strip_t* strip)
+{
+	host_strip_t* s = __containerof(strip, host_strip_t, parent);
+	free(s->rgb);
+	free(s);
+	return ESP_OK;
+}
+
+led_strip_t* led_strip_new_rmt(const led_strip_config_t* config)
+{
+	host_strip_t* s = calloc(1, sizeof(host_strip_t));
+	if (!s) {
+		return NULL;
+	}
+	s->rgb = calloc(config->max_leds, 3);
+	if (!s->rgb) {
+		free(s);
+		return NULL;
+	}
+	s->num = config->max_leds;
+	s->parent.set_pixel = host_strip_set_pixel;
+	s->parent.refresh = host_strip_refresh;
+	s->parent.clear = host_strip_clear;
+	s->parent.del = host_strip_del;
+	return &s->parent;
+}
+
+esp_err_t led_strip_rmt_get_stats(led_strip_t* strip, led_strip_rmt_stats_t* stats)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,17 @@
+#ifndef HOST_H
+#define HOST_H
+#include <stdint.h>
+
+/*
+ * What the host port adds for the tools built on it. The unit's esp_timer
+ * clock starts at 0 with the process, like on the ESP32, and can be set
+ * off and drifting from the machine's to simulate several units.
+ */
+/* Microseconds on the machine's clock since the process started */
+int64_t host_real_time(void);
+/* The unit's clock reads offset_us ahead and runs ppm parts per million fast */
+void host_set_clock(int64_t offset_us, int32_t ppm);
+/* fn gets every frame the strip sends out, 3 bytes per LED in RGB order */
+void host_strip_on_refresh(void (*fn)(const uint8_t* rgb, uint32_t num, void* arg), void* arg);
+
+#endif /* HOST_H */
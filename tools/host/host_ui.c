@@ -0,0 +1,84 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/adc.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "ssd1306.h"
+
+/*
+ * The UI's hardware for the tools that run ui.c: buttons that are never
+ * held, so only injected presses get through the debounce, a battery that
+ * always reads the same, and an OLED that draws nothing.
+ */
+
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+	return ESP_OK;
+}
+
+/* The buttons pull up, high is let go */
+int gpio_get_level(gpio_num_t gpio)
+{
+	return 1;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio, gpio_int_type_t type)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void* arg)
+{
+	return ESP_OK;
+}
+
+esp_err_t adc1_config_width(adc_bits_width_t width)
+{
+	return ESP_OK;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten)
+{
+	return ESP_OK;
+}
+
+/* About 3.7V once ui.c has scaled it */
+int adc1_get_raw(adc1_channel_t channel)
+{
+	return 2100;
+}
+
+void ssd1306_clear_screen(SSD1306_t* dev, bool invert)
+{
+}
+
+void ssd1306_display_text(SSD1306_t* dev, int page, char* text, int text_len, bool invert)
+{
+}
+
+void ssd1306_hardware_scroll(SSD1306_t* dev, ssd1306_scroll_type_t scroll)
+{
+}
+
+void ssd1306_contrast(SSD1306_t* dev, int contrast)
+{
+}
+
+void ssd1306_fadeout(SSD1306_t* dev)
+{
+}
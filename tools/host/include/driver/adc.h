@@ -0,0 +1,5 @@
+#ifndef HOST_DRIVER_ADC_H
+#define HOST_DRIVER_ADC_H
+#include "driver/adc_common.h"
+
+#endif /* HOST_DRIVER_ADC_H */
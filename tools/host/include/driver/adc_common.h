@@ -0,0 +1,24 @@
+#ifndef HOST_DRIVER_ADC_COMMON_H
+#define HOST_DRIVER_ADC_COMMON_H
+#include "esp_err.h"
+
+/* The battery voltage the UI shows, in host_ui.c */
+typedef enum {
+	ADC1_CHANNEL_7 = 7,
+} adc1_channel_t;
+
+typedef enum {
+	ADC_ATTEN_DB_11 = 3,
+} adc_atten_t;
+
+typedef enum {
+	ADC_WIDTH_BIT_12 = 3,
+} adc_bits_width_t;
+
+#define ADC_WIDTH_12Bit		ADC_WIDTH_BIT_12
+
+esp_err_t adc1_config_width(adc_bits_width_t width);
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten);
+int adc1_get_raw(adc1_channel_t channel);
+
+#endif /* HOST_DRIVER_ADC_COMMON_H */
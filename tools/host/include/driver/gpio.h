@@ -0,0 +1,15 @@
+#ifndef HOST_DRIVER_GPIO_H
+#define HOST_DRIVER_GPIO_H
+#include "esp_err.h"
+#include "hal/gpio_types.h"
+
+/* The buttons' pins, in host_ui.c. None of them is ever held down */
+esp_err_t gpio_config(const gpio_config_t* config);
+int gpio_get_level(gpio_num_t gpio);
+esp_err_t gpio_intr_enable(gpio_num_t gpio);
+esp_err_t gpio_intr_disable(gpio_num_t gpio);
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio, gpio_int_type_t type);
+esp_err_t gpio_install_isr_service(int flags);
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void* arg);
+
+#endif /* HOST_DRIVER_GPIO_H */
@@ -0,0 +1,10 @@
+#ifndef HOST_DRIVER_RMT_H
+#define HOST_DRIVER_RMT_H
+
+/* The strip is simulated in host.c, only the names main/ uses are here */
+typedef enum {
+	RMT_CHANNEL_0,
+	RMT_CHANNEL_MAX,
+} rmt_channel_t;
+
+#endif /* HOST_DRIVER_RMT_H */
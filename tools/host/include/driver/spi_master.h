@@ -0,0 +1,6 @@
+#ifndef HOST_DRIVER_SPI_MASTER_H
+#define HOST_DRIVER_SPI_MASTER_H
+
+/* Clocked strips aren't simulated, CONFIG_LED_STRIP_CLOCKED is always off */
+
+#endif /* HOST_DRIVER_SPI_MASTER_H */
@@ -0,0 +1,9 @@
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define DMA_ATTR	__attribute__((aligned(4)))
+#define RTC_NOINIT_ATTR
+
+#endif /* HOST_ESP_ATTR_H */
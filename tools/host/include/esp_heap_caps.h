@@ -0,0 +1,13 @@
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT		(1 << 2)
+
+/* The host heap has no numbers worth reporting, these all return 0 */
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+#endif /* HOST_ESP_HEAP_CAPS_H */
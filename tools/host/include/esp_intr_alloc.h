@@ -0,0 +1,6 @@
+#ifndef HOST_ESP_INTR_ALLOC_H
+#define HOST_ESP_INTR_ALLOC_H
+
+/* There are no interrupts on the host */
+
+#endif /* HOST_ESP_INTR_ALLOC_H */
@@ -0,0 +1,17 @@
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+#include <stdint.h>
+#include <stdio.h>
+
+/* Logs go to stderr, so tools can read what main/ prints on stdout */
+uint32_t esp_log_timestamp(void);
+
+#define HOST_LOG(letter, tag, format, ...) \
+	fprintf(stderr, letter " (%u) %s: " format "\n", esp_log_timestamp(), tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...)	HOST_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)	HOST_LOG("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)	HOST_LOG("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)	do { if (0) HOST_LOG("D", tag, format, ##__VA_ARGS__); } while (0)
+#define ESP_LOGV(tag, format, ...)	do { if (0) HOST_LOG("V", tag, format, ##__VA_ARGS__); } while (0)
+
+#endif /* HOST_ESP_LOG_H */
@@ -0,0 +1,7 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+#include <stdint.h>
+
+uint32_t esp_random(void);
+
+#endif /* HOST_ESP_SYSTEM_H */
@@ -0,0 +1,6 @@
+#ifndef HOST_FONT8X8_BASIC_H
+#define HOST_FONT8X8_BASIC_H
+
+/* ui.c includes it, the display in host_ui.c draws no text */
+
+#endif /* HOST_FONT8X8_BASIC_H */
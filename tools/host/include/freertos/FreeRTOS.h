@@ -0,0 +1,51 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_attr.h"
+#include "esp_err.h"
+
+/*
+ * Enough of FreeRTOS for main/ to run on Linux: tasks are threads, and
+ * critical sections are a recursive mutex each, since they nest on the ESP32
+ * too. Priorities and core affinity are ignored.
+ */
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+typedef struct host_task* TaskHandle_t;
+typedef struct host_queue* QueueHandle_t;
+typedef struct {
+	void* unused;
+} StaticTask_t;
+typedef struct {
+	void* unused;
+} StaticQueue_t;
+typedef pthread_mutex_t portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED	PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+#define portENTER_CRITICAL(mux)		pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux)		pthread_mutex_unlock(mux)
+#define portENTER_CRITICAL_ISR(mux)	pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL_ISR(mux)	pthread_mutex_unlock(mux)
+#define portENTER_CRITICAL_SAFE(mux)	pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL_SAFE(mux)	pthread_mutex_unlock(mux)
+
+#define configTICK_RATE_HZ	100
+#define portTICK_PERIOD_MS	(1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY		((TickType_t)0xffffffff)
+#define pdMS_TO_TICKS(ms)	((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+#define pdTRUE			1
+#define pdFALSE			0
+#define pdPASS			pdTRUE
+#define pdFAIL			pdFALSE
+#define tskNO_AFFINITY		0x7fffffff
+
+/* The ESP32's FreeRTOS headers bring these in from esp_bit_defs.h */
+#define BIT(n)			(1UL << (n))
+#define BIT64(n)		(1ULL << (n))
+
+#endif /* HOST_FREERTOS_H */
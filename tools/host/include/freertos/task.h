@@ -0,0 +1,33 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void* parameters);
+
+typedef enum {
+	eNoAction,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+} eNotifyAction;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* parameters,
+				   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack,
+					   void* parameters, UBaseType_t priority, StackType_t* stack_buf,
+					   StaticTask_t* task_buf, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char* pcTaskGetTaskName(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks);
+
+/* Interrupts are plain function calls on the host */
+#define xTaskNotifyFromISR(task, value, action, woken)	xTaskNotify(task, value, action)
+
+#endif /* HOST_FREERTOS_TASK_H */
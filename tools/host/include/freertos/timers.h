@@ -0,0 +1,7 @@
+#ifndef HOST_FREERTOS_TIMERS_H
+#define HOST_FREERTOS_TIMERS_H
+#include "freertos/FreeRTOS.h"
+
+/* No software timers, CONFIG_LED_MEM_REPORT_PERIOD is always 0 */
+
+#endif /* HOST_FREERTOS_TIMERS_H */
@@ -0,0 +1,7 @@
+#ifndef HOST_HAL_GPIO_LL_H
+#define HOST_HAL_GPIO_LL_H
+
+/* Light sleep isn't simulated, so nothing disarms the buttons' interrupts */
+#define gpio_ll_intr_disable(hw, gpio)
+
+#endif /* HOST_HAL_GPIO_LL_H */
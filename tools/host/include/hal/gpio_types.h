@@ -0,0 +1,48 @@
+#ifndef HOST_HAL_GPIO_TYPES_H
+#define HOST_HAL_GPIO_TYPES_H
+#include <stdint.h>
+
+/* Only the pins and modes the buttons use */
+typedef enum {
+	GPIO_NUM_32 = 32,
+	GPIO_NUM_33 = 33,
+	GPIO_NUM_34 = 34,
+	GPIO_NUM_36 = 36,
+	GPIO_NUM_39 = 39,
+	GPIO_NUM_MAX = 40,
+} gpio_num_t;
+
+typedef enum {
+	GPIO_MODE_INPUT = 1,
+} gpio_mode_t;
+
+typedef enum {
+	GPIO_PULLUP_DISABLE,
+	GPIO_PULLUP_ENABLE,
+} gpio_pullup_t;
+
+typedef enum {
+	GPIO_PULLDOWN_DISABLE,
+	GPIO_PULLDOWN_ENABLE,
+} gpio_pulldown_t;
+
+typedef enum {
+	GPIO_INTR_DISABLE,
+	GPIO_INTR_POSEDGE,
+	GPIO_INTR_NEGEDGE,
+	GPIO_INTR_ANYEDGE,
+	GPIO_INTR_LOW_LEVEL,
+	GPIO_INTR_HIGH_LEVEL,
+} gpio_int_type_t;
+
+typedef struct {
+	uint64_t pin_bit_mask;
+	gpio_mode_t mode;
+	gpio_pullup_t pull_up_en;
+	gpio_pulldown_t pull_down_en;
+	gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void* arg);
+
+#endif /* HOST_HAL_GPIO_TYPES_H */
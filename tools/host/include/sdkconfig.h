@@ -0,0 +1,41 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+#include <stddef.h>
+
+/*
+ * The host port's configuration, included ahead of every file. Options
+ * left out are off, and any of these can be changed with -D.
+ */
+#ifndef CONFIG_NUM_LEDS
+#define CONFIG_NUM_LEDS			300
+#endif
+#ifndef CONFIG_LED_RNG_SEED
+#define CONFIG_LED_RNG_SEED		0
+#endif
+#ifndef CONFIG_LED_ZONES
+#define CONFIG_LED_ZONES		1
+#endif
+#ifndef CONFIG_LED_SYNC_PRIORITY
+#define CONFIG_LED_SYNC_PRIORITY	128
+#endif
+#ifndef CONFIG_LED_RENDER_CHECK_SECONDS
+#define CONFIG_LED_RENDER_CHECK_SECONDS	10
+#endif
+#ifndef CONFIG_LED_INTERPOLATE_FPS
+#define CONFIG_LED_INTERPOLATE_FPS	100
+#endif
+#ifndef CONFIG_LED_DITHER_FPS
+#define CONFIG_LED_DITHER_FPS		200
+#endif
+#define CONFIG_LED_MEM_REPORT_PERIOD	0
+#define CONFIG_RMT_TX_GPIO		18
+#define CONFIG_LED_RMT_MEM_BLOCKS	4
+#define CONFIG_LED_RMT_INTR_LEVEL	3
+#define CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ 240
+
+/* newlib's sys/cdefs.h has this, glibc's doesn't */
+#ifndef __containerof
+#define __containerof(ptr, type, member) ((type*)((char*)(ptr) - offsetof(type, member)))
+#endif
+
+#endif /* HOST_SDKCONFIG_H */
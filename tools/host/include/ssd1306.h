@@ -0,0 +1,26 @@
+#ifndef HOST_SSD1306_H
+#define HOST_SSD1306_H
+#include <stdbool.h>
+
+/* The OLED, in host_ui.c, which draws nothing */
+typedef struct {
+	int width;
+	int height;
+	int pages;
+} SSD1306_t;
+
+typedef enum {
+	SCROLL_RIGHT = 1,
+	SCROLL_LEFT,
+	SCROLL_DOWN,
+	SCROLL_UP,
+	SCROLL_STOP,
+} ssd1306_scroll_type_t;
+
+void ssd1306_clear_screen(SSD1306_t* dev, bool invert);
+void ssd1306_display_text(SSD1306_t* dev, int page, char* text, int text_len, bool invert);
+void ssd1306_hardware_scroll(SSD1306_t* dev, ssd1306_scroll_type_t scroll);
+void ssd1306_contrast(SSD1306_t* dev, int contrast);
+void ssd1306_fadeout(SSD1306_t* dev);
+
+#endif /* HOST_SSD1306_H */
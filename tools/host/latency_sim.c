@@ -0,0 +1,52 @@
+/*
+ * Runs the UI and the LED task together and presses buttons through
+ * ui_buttons_inject(), timing each press on its way to the strip like a
+ * unit built with CONFIG_LED_LATENCY. The buttons, the battery ADC and the
+ * OLED are stand-ins, see host_ui.c. From tools/host:
+ *     make latency_sim
+ *     ./latency_sim [presses] 2>/dev/null | ../latency_report.py -
+ * The LATENCY lines go to stdout, the unit's logs to stderr.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "latency.h"
+#include "leds.h"
+#include "led_patterns.h"
+#include "palette.h"
+#include "ui.h"
+#include "ui_buttons.h"
+
+/* Past the splash screen */
+#define SIM_START_US		3000000
+/* Longer than latency.c waits for a probe that never reaches the strip */
+#define SIM_SETTLE_US		2500000
+/* Apart enough that each probe is done before the next press, even on a slow pattern */
+#define SIM_PRESS_US		400000
+/* Spread over a frame or two, so the presses land anywhere in one */
+#define SIM_JITTER_US		40000
+/* Long enough for the latency task to print the last ones */
+#define SIM_DRAIN_US		1500000
+
+int main(int argc, char** argv)
+{
+	uint32_t presses = (argc > 1) ? atoi(argv[1]) : 50;
+	led_init();
+	led_pattern_init();
+	palette_init();
+	ui_init();
+	latency_init();
+
+	/* Up opens the colour screen from idle, which changes nothing on the strip */
+	usleep(SIM_START_US);
+	ui_buttons_inject(UI_BTN_UP);
+	usleep(SIM_SETTLE_US);
+	/* Then right and left nudge the hue back and forth */
+	for (uint32_t i = 0; i < presses; i++) {
+		ui_buttons_inject((i & 1) ? UI_BTN_L : UI_BTN_R);
+		usleep(SIM_PRESS_US + rand() % SIM_JITTER_US);
+	}
+	usleep(SIM_DRAIN_US);
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Host benchmark for the layer stack, by default 1000 LEDs and four layers:
+ * the one zone and three overlays. The layers hold fixed gradients, so only
+ * the blending and compositing is timed. From tools/host:
+ *     make layers_bench
+ *     ./layers_bench
+ * Each blend mode is timed with every overlay using it, then with a mix.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "led_layers.h"
+
+#define BENCH_FRAMES	2000
+#define BENCH_OPACITY	200
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void report(const char* name, int64_t us, uint32_t num)
+{
+	double per_frame = (double)us / BENCH_FRAMES;
+	printf("%-10s %9.2f us/frame %7.2f ns/LED\n", name, per_frame, per_frame * 1000 / num);
+}
+
+/* A different gradient on each layer, drawn once */
+static void bench_init(led_frame_t* frame, void* state)
+{
+	uint32_t seed = (uintptr_t)frame->pixels >> 4;
+	for (uint32_t i = 0; i < frame->num; i++) {
+		uint8_t x = i * 256 / frame->num;
+		frame->pixels[i] = (led_rgb_t) { x + seed, 255 - x, (x * 3) ^ seed };
+	}
+}
+
+static uint32_t bench_render(led_frame_t* frame, void* state)
+{
+	return 1000000;
+}
+
+static led_pattern_t bench_pattern = { "Bench", 0, bench_init, bench_render };
+
+/* Put blends[l] on overlay l, and start everything on the next render */
+static void bench_set(const led_blend_t* blends)
+{
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		led_layer_params_t params = {
+			.pattern = &bench_pattern,
+			.blend = (l < LED_NUM_ZONES) ? LED_BLEND_ALPHA : blends[l - LED_NUM_ZONES],
+			.opacity = (l < LED_NUM_ZONES) ? 255 : BENCH_OPACITY,
+		};
+		led_layer_set(l, &params);
+	}
+	int64_t next;
+	led_layers_render(0, &next);
+}
+
+static void bench_composite(const char* name, led_frame_t* out, uint32_t* sum)
+{
+	int64_t start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		led_layers_composite(out);
+		*sum += out->pixels[f % out->num].r;
+	}
+	report(name, now_us() - start, out->num);
+}
+
+int main(void)
+{
+	static const char* names[LED_BLEND_NUM] = { "alpha", "add", "screen", "multiply", "max" };
+	static led_rgb_t pixels[CONFIG_NUM_LEDS];
+	led_frame_t out = { pixels, CONFIG_NUM_LEDS };
+	led_blend_t blends[LED_NUM_OVERLAYS];
+	uint32_t sum = 0;
+	printf("%u LEDs, %u layers\n", CONFIG_NUM_LEDS, LED_NUM_LAYERS);
+	led_layers_init(CONFIG_NUM_LEDS);
+
+	/* Only the zones, which is a copy */
+	for (uint8_t l = 0; l < LED_NUM_LAYERS; l++) {
+		led_layer_params_t params = { .pattern = (l < LED_NUM_ZONES) ? &bench_pattern : NULL };
+		led_layer_set(l, &params);
+	}
+	int64_t next;
+	led_layers_render(0, &next);
+	bench_composite("zones", &out, &sum);
+
+	for (led_blend_t blend = 0; blend < LED_BLEND_NUM; blend++) {
+		for (uint8_t l = 0; l < LED_NUM_OVERLAYS; l++) {
+			blends[l] = blend;
+		}
+		bench_set(blends);
+		bench_composite(names[blend], &out, &sum);
+	}
+
+	for (uint8_t l = 0; l < LED_NUM_OVERLAYS; l++) {
+		blends[l] = (LED_BLEND_ADD + l) % LED_BLEND_NUM;
+	}
+	bench_set(blends);
+	bench_composite("mixed", &out, &sum);
+	/* Keeps the loops from being optimised away */
+	return sum == 1;
+}
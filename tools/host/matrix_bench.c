@@ -0,0 +1,97 @@
+/*
+ * Host benchmark for the 2D effects and the XY mapping, by default on a
+ * 64x64 wall of 8x8 serpentine panels. From tools/host:
+ *     make matrix_bench
+ *     ./matrix_bench [width height]
+ * Width and height are rounded down to whole panels. The text is drawn with
+ * a solid block font, which costs the same as the real one.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "led_matrix.h"
+
+#define BENCH_FRAMES	500
+#define BENCH_PANEL	8
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void report(const char* name, int64_t us)
+{
+	double per_frame = (double)us / BENCH_FRAMES;
+	printf("%-8s %9.1f us/frame %9.0f fps\n", name, per_frame, 1000000.0 / per_frame);
+}
+
+int main(int argc, char** argv)
+{
+	uint16_t width = (argc > 2) ? atoi(argv[1]) : 64;
+	uint16_t height = (argc > 2) ? atoi(argv[2]) : 64;
+	led_matrix_config_t config = {
+		.panel_width = BENCH_PANEL,
+		.panel_height = BENCH_PANEL,
+		.panels_x = width / BENCH_PANEL,
+		.panels_y = height / BENCH_PANEL,
+		.serpentine = true,
+		.tiles_serpentine = true,
+	};
+	led_matrix_t matrix;
+	uint16_t* map = calloc((uint32_t)width * height, sizeof(uint16_t));
+	int64_t start = now_us();
+	if (!map || !led_matrix_init(&matrix, &config, map)) {
+		fprintf(stderr, "can't lay out %ux%u\n", width, height);
+		return 1;
+	}
+	printf("%ux%u, %u LEDs, map built in %lld us\n", matrix.width, matrix.height,
+	       matrix.width * matrix.height, (long long)(now_us() - start));
+
+	uint32_t num = matrix.width * matrix.height;
+	led_frame2d_t frame = { calloc(num, sizeof(led_rgb_t)), matrix.width, matrix.height };
+	led_rgb_t* strip = calloc(num, sizeof(led_rgb_t));
+	led_rgb_t palette[256];
+	uint8_t font[128 * 8];
+	uint32_t sum = 0;
+	for (int i = 0; i < 256; i++) {
+		palette[i] = (led_rgb_t) { i, 255 - i, i ^ 0x55 };
+	}
+	for (size_t i = 0; i < sizeof(font); i++) {
+		font[i] = 0xff;
+	}
+
+	start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		led_matrix_plasma(&frame, palette, f * 13);
+	}
+	report("plasma", now_us() - start);
+
+	start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		led_matrix_fire(&frame, f * 13);
+	}
+	report("fire", now_us() - start);
+
+	start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		led_matrix_text(&frame, font, "tubalux tubalux", matrix.width - f % 128, 0, palette[f & 255]);
+	}
+	report("text", now_us() - start);
+
+	/* What the output does on top of every effect */
+	start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		for (uint32_t i = 0; i < num; i++) {
+			strip[matrix.map[i]] = frame.pixels[i];
+		}
+		sum += strip[f % num].r;
+	}
+	report("map", now_us() - start);
+
+	/* Keeps the loops from being optimised away */
+	return sum == 1;
+}
@@ -0,0 +1,160 @@
+/*
+ * Host test for the MIDI parser. Each case is written to a pseudo-terminal
+ * in raw mode and read back from the other end, the way the UART delivers
+ * it, and fed through midi_parse(). From tools/host:
+ *     make midi_test
+ *     ./midi_test
+ * or make check, which runs every test. Exits non-zero if any case gives
+ * the wrong messages.
+ */
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "midi_parse.h"
+
+#define TEST_MAX_BYTES	32
+#define TEST_MAX_MSGS	8
+#define TEST_TIMEOUT_MS	1000
+
+typedef struct {
+	const char* name;
+	uint8_t bytes[TEST_MAX_BYTES];
+	uint8_t len;
+	midi_msg_t msgs[TEST_MAX_MSGS];
+	uint8_t num;
+} midi_case_t;
+
+#define MSG(s, d0, d1)	{ .status = s, .data = { d0, d1 } }
+
+static const midi_case_t cases[] = {
+	{
+		"running status",
+		{ 0x90, 0x3c, 0x64, 0x3e, 0x64, 0xb0, 0x07, 0x10, 0x07, 0x20, 0xc0, 0x05, 0x06 }, 13,
+		{ MSG(0x90, 0x3c, 0x64), MSG(0x90, 0x3e, 0x64), MSG(0xb0, 0x07, 0x10),
+		  MSG(0xb0, 0x07, 0x20), MSG(0xc0, 0x05, 0), MSG(0xc0, 0x06, 0) }, 6,
+	},
+	{
+		"real-time mid-message",
+		{ 0x90, 0xf8, 0x3c, 0xfa, 0x64, 0x3e, 0xf8, 0x64, 0xfc }, 9,
+		{ MSG(MIDI_CLOCK, 0, 0), MSG(MIDI_START, 0, 0), MSG(0x90, 0x3c, 0x64),
+		  MSG(MIDI_CLOCK, 0, 0), MSG(0x90, 0x3e, 0x64), MSG(MIDI_STOP, 0, 0) }, 6,
+	},
+	{
+		"sysex skipped",
+		{ 0xf0, 0x7e, 0x7f, 0x09, 0x01, 0xf7, 0x3c, 0x64, 0xf0, 0x01, 0xf8, 0x02, 0xf7, 0x91, 0x3c, 0x64 }, 16,
+		{ MSG(MIDI_CLOCK, 0, 0), MSG(0x91, 0x3c, 0x64) }, 2,
+	},
+	{
+		"note on velocity 0",
+		{ 0x92, 0x3c, 0x64, 0x3c, 0x00, 0x90, 0x40, 0x00 }, 8,
+		{ MSG(0x92, 0x3c, 0x64), MSG(0x82, 0x3c, 0x00), MSG(0x80, 0x40, 0x00) }, 3,
+	},
+};
+
+static bool midi_same(const midi_msg_t* a, const midi_msg_t* b)
+{
+	if (a->status != b->status) {
+		return false;
+	}
+	/* Only the data bytes a message has are set */
+	if (a->status >= 0xf0) {
+		return true;
+	}
+	uint8_t type = a->status & 0xf0;
+	bool two = type != MIDI_PROGRAM && type != 0xd0;
+	return a->data[0] == b->data[0] && (!two || a->data[1] == b->data[1]);
+}
+
+static void midi_print(const char* what, const midi_msg_t* msgs, uint8_t num)
+{
+	printf("    %-8s", what);
+	for (uint8_t i = 0; i < num; i++) {
+		printf(" %02x %02x %02x", msgs[i].status, msgs[i].data[0], msgs[i].data[1]);
+		printf((i + 1 < num) ? "," : "");
+	}
+	printf("\n");
+}
+
+/* Returns the number of bytes read, fewer if the pty went quiet */
+static uint32_t pty_read(int fd, uint8_t* buf, uint32_t len)
+{
+	uint32_t got = 0;
+	while (got < len) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		if (poll(&pfd, 1, TEST_TIMEOUT_MS) <= 0) {
+			break;
+		}
+		ssize_t n = read(fd, buf + got, len - got);
+		if (n <= 0) {
+			break;
+		}
+		got += n;
+	}
+	return got;
+}
+
+static bool midi_run(const midi_case_t* c, int master, int slave)
+{
+	uint8_t buf[TEST_MAX_BYTES];
+	midi_msg_t got[TEST_MAX_MSGS];
+	uint8_t num = 0;
+	midi_parser_t parser = { 0 };
+	if (write(master, c->bytes, c->len) != c->len) {
+		perror("write");
+		return false;
+	}
+	uint32_t len = pty_read(slave, buf, c->len);
+	for (uint32_t i = 0; i < len; i++) {
+		midi_msg_t msg = { 0 };
+		if (midi_parse(&parser, buf[i], &msg) && num < TEST_MAX_MSGS) {
+			got[num++] = msg;
+		}
+	}
+	bool ok = len == c->len && num == c->num;
+	for (uint8_t i = 0; ok && i < num; i++) {
+		ok = midi_same(&got[i], &c->msgs[i]);
+	}
+	printf("%-24s %s\n", c->name, ok ? "ok" : "FAIL");
+	if (!ok) {
+		printf("    %u of %u bytes came through\n", len, c->len);
+		midi_print("got", got, num);
+		midi_print("expected", c->msgs, c->num);
+	}
+	return ok;
+}
+
+int main(void)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+		perror("pty");
+		return 1;
+	}
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	struct termios tio;
+	if (slave < 0 || tcgetattr(slave, &tio) < 0) {
+		perror("pty");
+		return 1;
+	}
+	/* Every byte through untouched, like a UART */
+	cfmakeraw(&tio);
+	if (tcsetattr(slave, TCSANOW, &tio) < 0) {
+		perror("tcsetattr");
+		return 1;
+	}
+
+	uint32_t failed = 0;
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		failed += !midi_run(&cases[i], master, slave);
+	}
+	close(slave);
+	close(master);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Host benchmark for the particle engine, by default with 1000 particles on
+ * a strip of 300 LEDs. From tools/host:
+ *     make particles_bench
+ *     ./particles_bench [particles [leds]]
+ * The pool is topped up every frame, so it stays full of particles at every
+ * stage of their lives, with tails of up to 8 pixels.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "particles.h"
+
+#define BENCH_FRAMES	2000
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void report(const char* name, int64_t us, uint32_t num)
+{
+	double per_frame = (double)us / BENCH_FRAMES;
+	printf("%-8s %9.1f us/frame %7.1f ns/particle\n", name, per_frame, per_frame * 1000 / num);
+}
+
+static void top_up(particles_t* p, rng_t* rng, uint32_t len)
+{
+	particles_emitter_t e = { .spread = PARTICLES_FIXED(1), .bright = 255 };
+	while (p->num < p->capacity) {
+		e.pos = PARTICLES_FIXED(rng_below(rng, len));
+		e.fade = rng_range(rng, 1, 8);
+		e.tail = rng_below(rng, 9);
+		e.color = (led_rgb_t) { rng_next(rng), rng_next(rng), rng_next(rng) };
+		particles_emit(p, &e, rng);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t num = (argc > 1) ? atoi(argv[1]) : 1000;
+	uint32_t len = (argc > 2) ? atoi(argv[2]) : 300;
+	void* storage = malloc(PARTICLES_STORAGE_SIZE(num));
+	led_frame_t frame = { calloc(len, sizeof(led_rgb_t)), len };
+	rng_t rng = { 1 };
+	particles_t pool;
+	uint32_t sum = 0;
+	if (!num || num > UINT16_MAX || !len || !storage || !frame.pixels) {
+		fprintf(stderr, "can't bench %u particles on %u LEDs\n", num, len);
+		return 1;
+	}
+	particles_init(&pool, storage, num);
+	pool.drag = 8;
+	printf("%u particles, %u LEDs\n", num, len);
+
+	int64_t step = 0;
+	int64_t render = 0;
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		top_up(&pool, &rng, len);
+		int64_t start = now_us();
+		particles_step(&pool, len);
+		int64_t mid = now_us();
+		led_frame_clear(&frame);
+		particles_render(&pool, &frame);
+		render += now_us() - mid;
+		step += mid - start;
+		sum += frame.pixels[f % len].g;
+	}
+	report("step", step, num);
+	report("render", render, num);
+	report("total", step + render, num);
+
+	/* Keeps the loops from being optimised away */
+	return sum == 1;
+}
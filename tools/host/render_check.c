@@ -0,0 +1,27 @@
+/*
+ * Runs the CONFIG_LED_RENDER_CHECK pass that a unit runs at boot, on this
+ * machine, so patterns and colour maths can be checked without flashing
+ * anything. The RENDER lines go to stdout and the logs to stderr. From
+ * tools/host:
+ *     make render_check
+ *     ./render_check > render.log
+ *     ../render_check.py render.log -g render.golden
+ * with -u on the first run to record the golden checksums.
+ */
+#include <stdio.h>
+#include <unistd.h>
+
+#include "leds.h"
+#include "led_patterns.h"
+#include "palette.h"
+
+int main(void)
+{
+	led_pattern_init();
+	palette_init();
+	/* The check runs in here, before the LED task starts */
+	led_init();
+	fflush(stdout);
+	/* Without waiting for the LED task */
+	_exit(0);
+}
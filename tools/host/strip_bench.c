@@ -0,0 +1,103 @@
+/*
+ * Host benchmark for the noise kernel and the patterns built on it, on a
+ * strip of 300 LEDs by default. The noise is sampled along the strip the way
+ * the flames do, at each number of octaves they could use. From tools/host:
+ *     make strip_bench
+ *     ./strip_bench [leds]
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "led_patterns.h"
+#include "noise.h"
+
+#define BENCH_FRAMES	2000
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void report(const char* name, int64_t us, uint32_t num)
+{
+	double per_frame = (double)us / BENCH_FRAMES;
+	printf("%-14s %9.2f us/frame %7.2f ns/LED\n", name, per_frame, per_frame * 1000 / num);
+}
+
+static void bench_pattern(const char* name, led_frame_t* frame, uint32_t* sum)
+{
+	led_pattern_t* pattern = NULL;
+	for (uint32_t p = 0; p < LED_NUM_PATTERNS; p++) {
+		if (!strcmp(get_patterns()[p].name, name)) {
+			pattern = &get_patterns()[p];
+		}
+	}
+	void* state = pattern ? calloc(1, pattern->state_size) : NULL;
+	if (!state) {
+		printf("%-14s missing\n", name);
+		return;
+	}
+	if (pattern->init) {
+		pattern->init(frame, state);
+	}
+	int64_t start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		pattern->render(frame, state);
+		*sum += frame->pixels[f % frame->num].r;
+	}
+	report(name, now_us() - start, frame->num);
+	free(state);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t num = (argc > 1) ? atoi(argv[1]) : 300;
+	led_frame_t frame = { calloc(num, sizeof(led_rgb_t)), num };
+	uint32_t sum = 0;
+	char name[16];
+	if (!num || !frame.pixels) {
+		fprintf(stderr, "can't make a strip of %u\n", num);
+		return 1;
+	}
+	printf("%u LEDs\n", num);
+
+	for (uint8_t octaves = 1; octaves <= 8; octaves++) {
+		int64_t start = now_us();
+		for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+			for (uint32_t i = 0; i < num; i++) {
+				sum += noise8_octaves_1d((i << 5) + (f << 3), octaves);
+			}
+		}
+		snprintf(name, sizeof(name), "1d, %u oct", octaves);
+		report(name, now_us() - start, num);
+	}
+	for (uint8_t octaves = 1; octaves <= 8; octaves++) {
+		int64_t start = now_us();
+		for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+			for (uint32_t i = 0; i < num; i++) {
+				sum += noise8_octaves_2d(i << 5, f << 3, octaves);
+			}
+		}
+		snprintf(name, sizeof(name), "2d, %u oct", octaves);
+		report(name, now_us() - start, num);
+	}
+	int64_t start = now_us();
+	for (uint32_t f = 0; f < BENCH_FRAMES; f++) {
+		for (uint32_t i = 0; i < num; i++) {
+			sum += noise8_3d(i << 5, f << 3, f << 2);
+		}
+	}
+	report("3d", now_us() - start, num);
+
+	bench_pattern("R flame", &frame, &sum);
+	bench_pattern("RB flame", &frame, &sum);
+	bench_pattern("Plasma", &frame, &sum);
+
+	/* Keeps the loops from being optimised away */
+	return sum == 1;
+}
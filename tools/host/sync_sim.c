@@ -0,0 +1,189 @@
+/*
+ * Runs several units as processes on this machine, synced over UDP
+ * multicast with loopback, with their clocks minutes apart and drifting by
+ * tens of ppm. They start half a second apart, so later ones join a running
+ * group. Each reports when its frames went out on the machine's clock, and
+ * every frame in the second half of the run is compared with the nearest
+ * frame of the first unit. From tools/host:
+ *     make sync_sim
+ *     ./sync_sim [units [seconds]] 2>/dev/null
+ * The units' own logs go to stderr.
+ */
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "leds.h"
+#include "led_patterns.h"
+#include "palette.h"
+#include "sync.h"
+
+/* The Kconfig defaults */
+#define SIM_GROUP	"239.84.76.88"
+#define SIM_PORT	5858
+#define SIM_MAX_UNITS	8
+#define SIM_STAGGER_US	500000
+
+typedef struct {
+	int fd;
+	pid_t pid;
+	int64_t* frames;
+	uint32_t num;
+	uint32_t size;
+} sim_unit_t;
+
+static int frame_fd;
+
+static void sim_refresh(const uint8_t* rgb, uint32_t num, void* arg)
+{
+	int64_t now = host_real_time();
+	if (write(frame_fd, &now, sizeof(now)) != sizeof(now)) {
+		_exit(1);
+	}
+}
+
+static void sim_run(uint32_t i, uint32_t seconds)
+{
+	/* Every other unit runs slow, and each booted minutes after the last */
+	int32_t ppm = (i & 1) ? -(int32_t)(30 + i) : (int32_t)(30 + i);
+	int64_t offset = (int64_t)i * 150000000;
+	usleep(i * SIM_STAGGER_US);
+	host_set_clock(offset, ppm);
+	host_strip_on_refresh(sim_refresh, NULL);
+	led_init();
+	led_pattern_init();
+	palette_init();
+	sync_init(sync_transport_new_udp(SIM_GROUP, SIM_PORT));
+	usleep(seconds * 1000000 - i * SIM_STAGGER_US);
+	_exit(0);
+}
+
+static void sim_read(sim_unit_t* u)
+{
+	int64_t t;
+	if (read(u->fd, &t, sizeof(t)) != sizeof(t)) {
+		close(u->fd);
+		u->fd = -1;
+		return;
+	}
+	if (u->num == u->size) {
+		u->size = u->size ? u->size * 2 : 1024;
+		u->frames = realloc(u->frames, u->size * sizeof(int64_t));
+		if (!u->frames) {
+			abort();
+		}
+	}
+	u->frames[u->num++] = t;
+}
+
+static int sim_cmp(const void* a, const void* b)
+{
+	int64_t x = *(const int64_t*)a;
+	int64_t y = *(const int64_t*)b;
+	return (x > y) - (x < y);
+}
+
+/* How far each frame of u in from - to was from the nearest frame of ref */
+static void sim_compare(uint32_t i, const sim_unit_t* u, const sim_unit_t* ref, int64_t from, int64_t to)
+{
+	int64_t* off = malloc(u->num * sizeof(int64_t));
+	uint32_t num = 0;
+	uint32_t r = 0;
+	for (uint32_t f = 0; f < u->num && off; f++) {
+		int64_t t = u->frames[f];
+		if (t < from || t > to) {
+			continue;
+		}
+		while (r + 1 < ref->num && ref->frames[r + 1] <= t) {
+			r++;
+		}
+		int64_t d = llabs(ref->frames[r] - t);
+		if (r + 1 < ref->num && llabs(ref->frames[r + 1] - t) < d) {
+			d = llabs(ref->frames[r + 1] - t);
+		}
+		off[num++] = d;
+	}
+	if (!num) {
+		printf("unit %u: no frames to compare\n", i);
+		free(off);
+		return;
+	}
+	qsort(off, num, sizeof(int64_t), sim_cmp);
+	printf("unit %u: %5u frames, off by %6lld us median, %6lld us worst\n", i, num,
+	       (long long)off[num / 2], (long long)off[num - 1]);
+	free(off);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t units = (argc > 1) ? atoi(argv[1]) : 3;
+	uint32_t seconds = (argc > 2) ? atoi(argv[2]) : 20;
+	sim_unit_t sim[SIM_MAX_UNITS] = { 0 };
+	if (units < 2 || units > SIM_MAX_UNITS || seconds < 2) {
+		fprintf(stderr, "can't run %u units for %u s\n", units, seconds);
+		return 1;
+	}
+	printf("%u units for %u s\n", units, seconds);
+	fflush(stdout);
+
+	/* Before any threads, so every unit starts with a clean process */
+	for (uint32_t i = 0; i < units; i++) {
+		int fds[2];
+		if (pipe(fds) < 0) {
+			perror("pipe");
+			return 1;
+		}
+		sim[i].pid = fork();
+		if (sim[i].pid < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (!sim[i].pid) {
+			close(fds[0]);
+			frame_fd = fds[1];
+			sim_run(i, seconds);
+		}
+		close(fds[1]);
+		sim[i].fd = fds[0];
+	}
+
+	uint32_t open = units;
+	while (open) {
+		struct pollfd pfd[SIM_MAX_UNITS];
+		for (uint32_t i = 0; i < units; i++) {
+			pfd[i] = (struct pollfd) { .fd = sim[i].fd, .events = POLLIN };
+		}
+		if (poll(pfd, units, -1) < 0) {
+			perror("poll");
+			return 1;
+		}
+		for (uint32_t i = 0; i < units; i++) {
+			if (pfd[i].revents) {
+				sim_read(&sim[i]);
+				open -= (sim[i].fd < 0);
+			}
+		}
+	}
+	int failed = 0;
+	for (uint32_t i = 0; i < units; i++) {
+		int status;
+		waitpid(sim[i].pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+			printf("unit %u: died\n", i);
+			failed = 1;
+		}
+	}
+
+	/* The first half is for finding each other and settling the clocks */
+	int64_t from = seconds * 1000000LL / 2;
+	int64_t to = seconds * 1000000LL - SIM_STAGGER_US;
+	for (uint32_t i = 1; i < units; i++) {
+		sim_compare(i, &sim[i], &sim[0], from, to);
+	}
+	return failed;
+}
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Report button to light latency from a CONFIG_LED_LATENCY run.
+
+Save the monitor output of a unit built with CONFIG_LED_LATENCY, pressing
+buttons or with CONFIG_LED_LATENCY_INJECT_MS set, e.g.
+    idf.py monitor | tee latency.log
+then
+    tools/latency_report.py latency.log
+prints percentiles of each stage of the path and of the whole of it. Give
+the log of an earlier build with --baseline to see what a change gained.
+"""
+import argparse
+import re
+import sys
+
+LATENCY_RE = re.compile(r'LATENCY((?: \d+){5})\s*$')
+# Stages after the press, in the order of the LATENCY line
+STAGES = ['debounced', 'UI task', 'applied', 'rendered', 'lit']
+
+
+def read_log(log):
+    probes = []
+    for line in log:
+        m = LATENCY_RE.search(line)
+        if m:
+            probes.append([int(t) for t in m.group(1).split()])
+    return probes
+
+
+def pick(samples, p):
+    return samples[min(len(samples) - 1, int(p * len(samples)))]
+
+
+def percentiles(samples):
+    samples = sorted(samples)
+    return (pick(samples, 0.5), pick(samples, 0.9), pick(samples, 0.99), samples[-1])
+
+
+def report(probes):
+    print('%-22s %9s %9s %9s %9s' % ('stage (ms)', 'p50', 'p90', 'p99', 'max'))
+    prev = 'press'
+    for s, stage in enumerate(STAGES):
+        steps = [p[s] - (p[s - 1] if s else 0) for p in probes]
+        print('%-22s %9.2f %9.2f %9.2f %9.2f' % ('%s -> %s' % (prev, stage),
+                                                 *(t / 1000 for t in percentiles(steps))))
+        prev = stage
+    total = percentiles([p[-1] for p in probes])
+    print('%-22s %9.2f %9.2f %9.2f %9.2f' % ('press -> lit', *(t / 1000 for t in total)))
+    return total
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('log', type=argparse.FileType('r', errors='replace'),
+                        help='monitor output containing LATENCY lines')
+    parser.add_argument('-b', '--baseline', type=argparse.FileType('r', errors='replace'),
+                        help='monitor output of an earlier build to compare with')
+    args = parser.parse_args()
+
+    probes = read_log(args.log)
+    if not probes:
+        sys.exit('no LATENCY lines found')
+    print('%d presses' % len(probes))
+    total = report(probes)
+
+    if args.baseline:
+        base = read_log(args.baseline)
+        if not base:
+            sys.exit('no LATENCY lines found in the baseline')
+        print('\nbaseline, %d presses' % len(base))
+        base_total = report(base)
+        print('\npress -> lit p50 %+.2f ms, p90 %+.2f ms' % ((total[0] - base_total[0]) / 1000,
+                                                            (total[1] - base_total[1]) / 1000))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Compare a CONFIG_LED_RENDER_CHECK run with a golden one and report throughput.
+
+Save the monitor output of a unit built with CONFIG_LED_RENDER_CHECK, e.g.
+    idf.py monitor | tee render.log
+record it as the reference once:
+    tools/render_check.py render.log --golden render.golden --update
+and after changing patterns or colour maths, check nothing moved:
+    tools/render_check.py render.log --golden render.golden
+Frame rates are always printed. With CONFIG_LED_RENDER_CHECK_PIXELS the
+frames can be written out as PNGs, one row per frame, with --png DIR, or as
+raw RGB with --raw DIR.
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+import zlib
+
+FRAME_RE = re.compile(r'RENDER (\d+) (\d+) (-?\d+) ([0-9a-f]{8})(?: ([0-9a-f]+))?')
+DONE_RE = re.compile(r'RENDER_DONE (\d+) (\d+) (\d+) (.+)')
+
+
+def read_run(log):
+    """Returns {pattern: {'name', 'frames': [(time, crc, pixels)], 'busy'}}"""
+    run = {}
+    for line in log:
+        m = FRAME_RE.search(line)
+        if m:
+            pattern, _, time, crc, pixels = m.groups()
+            entry = run.setdefault(int(pattern), {'name': str(pattern), 'frames': [], 'busy': 0})
+            entry['frames'].append((int(time), crc, bytes.fromhex(pixels) if pixels else None))
+            continue
+        m = DONE_RE.search(line)
+        if m:
+            pattern, _, busy, name = m.groups()
+            entry = run.setdefault(int(pattern), {'name': name, 'frames': [], 'busy': 0})
+            entry['name'] = name.strip()
+            entry['busy'] = int(busy)
+    return run
+
+
+def write_golden(run, out):
+    for pattern, entry in sorted(run.items()):
+        out.write('PATTERN %d %s\n' % (pattern, entry['name']))
+        for time, crc, _ in entry['frames']:
+            out.write('%d %s\n' % (time, crc))
+
+
+def read_golden(golden):
+    run = {}
+    frames = None
+    for line in golden:
+        if line.startswith('PATTERN '):
+            _, pattern, name = line.rstrip('\n').split(' ', 2)
+            frames = []
+            run[int(pattern)] = {'name': name, 'frames': frames}
+        elif line.strip():
+            time, crc = line.split()
+            frames.append((int(time), crc))
+    return run
+
+
+def compare(run, golden):
+    """Print the first differing frame of each pattern, returns the number that differ"""
+    failed = 0
+    for pattern, want in sorted(golden.items()):
+        got = run.get(pattern)
+        if not got:
+            print('%-12s missing' % want['name'])
+            failed += 1
+            continue
+        frames = [(t, c) for t, c, _ in got['frames']]
+        for i, (a, b) in enumerate(zip(frames, want['frames'])):
+            if a != b:
+                print('%-12s differs from frame %d at %d us' % (want['name'], i, b[0]))
+                failed += 1
+                break
+        else:
+            if len(frames) != len(want['frames']):
+                print('%-12s has %d frames, expected %d' % (want['name'], len(frames), len(want['frames'])))
+                failed += 1
+    return failed
+
+
+def write_png(path, rows):
+    width = len(rows[0]) // 3
+    raw = b''.join(b'\0' + row for row in rows)
+
+    def chunk(kind, data):
+        return struct.pack('>I', len(data)) + kind + data + struct.pack('>I', zlib.crc32(kind + data))
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, len(rows), 8, 2, 0, 0, 0)))
+        f.write(chunk(b'IDAT', zlib.compress(raw)))
+        f.write(chunk(b'IEND', b''))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('log', type=argparse.FileType('r', errors='replace'),
+                        help='monitor output containing RENDER lines')
+    parser.add_argument('-g', '--golden', help='golden checksums to compare with')
+    parser.add_argument('-u', '--update', action='store_true', help='write the golden file instead')
+    parser.add_argument('--png', metavar='DIR', help='write each pattern as a PNG')
+    parser.add_argument('--raw', metavar='DIR', help='write each pattern as raw RGB frames')
+    args = parser.parse_args()
+
+    run = read_run(args.log)
+    if not run:
+        sys.exit('no RENDER lines found')
+
+    print('%-12s %7s %10s %9s %8s' % ('pattern', 'frames', 'render us', 'fps', 'speedup'))
+    for pattern, entry in sorted(run.items()):
+        num = len(entry['frames'])
+        busy = max(entry['busy'], 1)
+        simulated = entry['frames'][-1][0] if entry['frames'] else 0
+        print('%-12s %7d %10d %9d %7dx' % (entry['name'], num, entry['busy'],
+                                           num * 1000000 // busy, simulated // busy))
+
+    for out_dir in (args.png, args.raw):
+        if out_dir:
+            os.makedirs(out_dir, exist_ok=True)
+    for pattern, entry in sorted(run.items()):
+        rows = [pixels for _, _, pixels in entry['frames'] if pixels]
+        if not rows:
+            continue
+        name = re.sub(r'\W+', '_', entry['name']).strip('_').lower() or str(pattern)
+        if args.png:
+            write_png(os.path.join(args.png, '%02d_%s.png' % (pattern, name)), rows)
+        if args.raw:
+            with open(os.path.join(args.raw, '%02d_%s.rgb' % (pattern, name)), 'wb') as f:
+                f.write(b''.join(rows))
+
+    if not args.golden:
+        return
+    if args.update:
+        with open(args.golden, 'w') as f:
+            write_golden(run, f)
+        print('wrote %s' % args.golden)
+        return
+    with open(args.golden) as f:
+        failed = compare(run, read_golden(f))
+    if failed:
+        sys.exit('%d patterns changed' % failed)
+    print('all %d patterns match' % len(run))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Encode frames recorded with CONFIG_LED_SHOW_RECORD into a tubalux show.
+
+Record a pattern by saving the monitor output, e.g.
+    idf.py monitor | tee show.log
+then encode and flash it:
+    tools/show_encode.py show.log show.bin
+    parttool.py write_partition --partition-name show --input show.bin
+
+See main/led_show.h for the format.
+"""
+import argparse
+import re
+import struct
+import sys
+
+SHOW_MAGIC = 0x584c4254
+SHOW_VERSION = 2
+KEYFRAME = 0
+DELTA = 1
+
+LINE_RE = re.compile(r'SHOW (\d+) (\d+) (\d+) ([0-9a-f]+)')
+
+
+def read_frames(log):
+    frames = []
+    for line in log:
+        m = LINE_RE.search(line)
+        if not m:
+            continue
+        timestamp, period, num, data = m.groups()
+        frames.append((int(timestamp), int(period), int(num), bytes.fromhex(data)))
+    return frames
+
+
+def encode_delta(prev, cur):
+    """Run-length code prev XOR cur as skip/literal runs of up to 128 bytes"""
+    xor = bytes(a ^ b for a, b in zip(prev, cur))
+    out = bytearray()
+    last_literal_end = 0
+    i = 0
+    while i < len(xor):
+        start = i
+        if xor[i] == 0:
+            while i < len(xor) and xor[i] == 0 and i - start < 128:
+                i += 1
+            out.append(i - start - 1)
+        else:
+            # A single unchanged byte costs a whole control byte, so only
+            # break a literal run on two or more unchanged bytes
+            while i < len(xor) and i - start < 128 and \
+                    (xor[i] or (i + 1 < len(xor) and xor[i + 1])):
+                i += 1
+            out.append(0x80 | (i - start - 1))
+            out += xor[start:i]
+            last_literal_end = len(out)
+    # Trailing unchanged bytes don't need encoding
+    return bytes(out[:last_literal_end])
+
+
+def encode(frames, keyframe_interval):
+    _, period, num, first = frames[0]
+    frame_size = len(first)
+    if frame_size % num:
+        sys.exit('frame size %d is not a multiple of %d LEDs' % (frame_size, num))
+
+    records = bytearray()
+    prev = None
+    since_key = 0
+    for i, (timestamp, _, _, data) in enumerate(frames):
+        if len(data) != frame_size:
+            sys.exit('frame %d is %d bytes, expected %d' % (i, len(data), frame_size))
+        if i + 1 < len(frames):
+            duration = frames[i + 1][0] - timestamp
+        else:
+            duration = period
+        duration = max(0, min(duration, 0xffff))
+
+        ftype, payload = KEYFRAME, data
+        if prev is not None and since_key < keyframe_interval:
+            delta = encode_delta(prev, data)
+            if len(delta) < len(data):
+                ftype, payload = DELTA, delta
+        since_key = 0 if ftype == KEYFRAME else since_key + 1
+
+        records += struct.pack('<BBHI', ftype, 0, duration, len(payload))
+        records += payload
+        records += bytes(-len(payload) % 4)
+        prev = data
+
+    header = struct.pack('<IHBBIII', SHOW_MAGIC, SHOW_VERSION, frame_size // num, 0,
+                         num, len(frames), period)
+    return header + records
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('log', type=argparse.FileType('r', errors='replace'),
+                        help='monitor output containing SHOW lines')
+    parser.add_argument('output', type=argparse.FileType('wb'), help='show image to write')
+    parser.add_argument('-k', '--keyframe', type=int, default=64,
+                        help='maximum frames between keyframes (default 64)')
+    args = parser.parse_args()
+
+    frames = read_frames(args.log)
+    if not frames:
+        sys.exit('no recorded frames found')
+    show = encode(frames, args.keyframe)
+    args.output.write(show)
+    raw = sum(len(f[3]) for f in frames)
+    print('%d frames, %d bytes (%d%% of raw)' % (len(frames), len(show), 100 * len(show) // raw))
+
+
+if __name__ == '__main__':
+    main()
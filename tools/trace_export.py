@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Convert a CONFIG_LED_TRACE dump into Chrome trace_event JSON.
+
+Save the monitor output of a unit built with CONFIG_LED_TRACE, e.g.
+    idf.py monitor | tee trace.log
+then convert the last dump in it:
+    tools/trace_export.py trace.log trace.json
+and open trace.json in chrome://tracing or https://ui.perfetto.dev. Each core
+gets a track for tasks, one for interrupts and one for marked spans. A
+summary of the spans and interrupts is printed too.
+"""
+import argparse
+import json
+import re
+import sys
+
+DUMP_RE = re.compile(r'TRACE_DUMP (\d+) (\d+)')
+ID_RE = re.compile(r'TRACE_ID (\d+) (.+)')
+TASK_RE = re.compile(r'TRACE_TASK ([0-9a-f]+) (.+)')
+EVENT_RE = re.compile(r'TRACE (\d+) (\d+) (\d+) ([0-9a-f]+)')
+
+TASK_IN, TASK_OUT, ISR_ENTER, ISR_EXIT, BEGIN, END = range(6)
+TRACKS = ('tasks', 'interrupts', 'spans')
+
+
+def read_dumps(log):
+    """Returns a list of dumps, each {'ids', 'tasks', 'events': [(core, type, time, arg)]}"""
+    dumps = []
+    dump = None
+    for line in log:
+        if DUMP_RE.search(line):
+            dump = {'ids': {}, 'tasks': {}, 'events': []}
+            continue
+        if dump is None:
+            continue
+        if 'TRACE_DONE' in line:
+            dumps.append(dump)
+            dump = None
+            continue
+        m = ID_RE.search(line)
+        if m:
+            dump['ids'][int(m.group(1))] = m.group(2).strip()
+            continue
+        m = TASK_RE.search(line)
+        if m:
+            dump['tasks'][int(m.group(1), 16)] = m.group(2).strip()
+            continue
+        m = EVENT_RE.search(line)
+        if m:
+            dump['events'].append((int(m.group(1)), int(m.group(2)),
+                                   int(m.group(3)), int(m.group(4), 16)))
+    return dumps
+
+
+def unwrap(events):
+    """Timestamps are the low 32 bits of esp_timer, make them run on from the first one"""
+    out = []
+    base = None
+    last = 0
+    wraps = 0
+    for core, kind, time, arg in events:
+        if base is None:
+            base = time
+        if time < last and last - time > 1 << 31:
+            wraps += 1
+        last = time
+        out.append((core, kind, time + (wraps << 32) - base, arg))
+    return out
+
+
+def export(dump):
+    """Returns (trace_events, {span name: [durations]})"""
+    trace = []
+    durations = {}
+    running = {}        # core: (task name, start)
+    isrs = {}           # core: [(name, start)]
+    spans = {}          # (core, name): start
+    cores = set()
+    end = 0
+
+    def span(core, track, name, start, stop):
+        trace.append({'name': name, 'ph': 'X', 'pid': 0, 'tid': core * len(TRACKS) + track,
+                      'ts': start, 'dur': stop - start})
+        if track:
+            durations.setdefault(name, []).append(stop - start)
+
+    for core, kind, time, arg in unwrap(dump['events']):
+        cores.add(core)
+        end = max(end, time)
+        if kind == TASK_IN:
+            running[core] = (dump['tasks'].get(arg, '%08x' % arg), time)
+        elif kind == TASK_OUT and core in running:
+            name, start = running.pop(core)
+            span(core, 0, name, start, time)
+        elif kind == ISR_ENTER:
+            isrs.setdefault(core, []).append((dump['ids'].get(arg, str(arg)), time))
+        elif kind == ISR_EXIT and isrs.get(core):
+            name, start = isrs[core].pop()
+            span(core, 1, name, start, time)
+        elif kind == BEGIN:
+            spans[(core, arg)] = time
+        elif kind == END and (core, arg) in spans:
+            span(core, 2, dump['ids'].get(arg, str(arg)), spans.pop((core, arg)), time)
+    # Whatever was still running when the dump started
+    for core, (name, start) in running.items():
+        span(core, 0, name, start, end)
+
+    for core in sorted(cores):
+        for track, name in enumerate(TRACKS):
+            trace.append({'name': 'thread_name', 'ph': 'M', 'pid': 0,
+                          'tid': core * len(TRACKS) + track,
+                          'args': {'name': 'core %d %s' % (core, name)}})
+    trace.append({'name': 'process_name', 'ph': 'M', 'pid': 0, 'args': {'name': 'tubalux'}})
+    return trace, durations
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('log', type=argparse.FileType('r'), help='monitor output')
+    parser.add_argument('json', nargs='?', help='where to write the trace, default stdout')
+    parser.add_argument('-n', '--dump', type=int, default=-1,
+                        help='which dump to convert, counting from 0, default the last')
+    args = parser.parse_args()
+
+    dumps = read_dumps(args.log)
+    if not dumps:
+        sys.exit('%s: no complete trace dump' % args.log.name)
+    try:
+        dump = dumps[args.dump]
+    except IndexError:
+        sys.exit('%s: only %d dumps' % (args.log.name, len(dumps)))
+
+    trace, durations = export(dump)
+    out = open(args.json, 'w') if args.json else sys.stdout
+    json.dump({'traceEvents': trace, 'displayTimeUnit': 'ms'}, out)
+    if args.json:
+        out.close()
+
+    print('%d events, dump %d of %d' % (len(dump['events']), args.dump % len(dumps) + 1, len(dumps)),
+          file=sys.stderr)
+    print('%-10s %6s %9s %9s' % ('span', 'count', 'mean us', 'max us'), file=sys.stderr)
+    for name, times in sorted(durations.items()):
+        print('%-10s %6d %9d %9d' % (name, len(times), sum(times) / len(times), max(times)),
+              file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()